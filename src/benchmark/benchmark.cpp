@@ -0,0 +1,325 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+// Steps every canned scene at several grid sizes and reports steps per second,
+// nanoseconds per cell and nanoseconds per active cell, as CSV or JSON.
+//
+// Usage: particle-benchmark [--format csv|json] [--output FILE] [--sizes 256,512,1024]
+//                           [--steps N] [--warmup N] [--threads N] [--seed N] [--scene NAME]
+//                           [--boundary solid|wrap|open] [--step-mode rects|active|sand-bits]
+//                           [--simd scalar|sse2|avx2|avx512]
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "engine/grid.h"
+#include "engine/materials.h"
+#include "engine/parse.h"
+#include "engine/scenes.h"
+#include "engine/simd.h"
+#include "engine/simulation.h"
+#include "engine/thread_pool.h"
+
+struct BenchmarkOptions
+{
+    std::string format = "csv";
+    std::string outputPath;
+    std::string sceneName;
+    std::vector<int> sizes = { 256, 512, 1024 };
+    int stepCount = 200;
+    int warmupCount = 20;
+    int threadCount = 1;
+    unsigned int seed = 42;
+    BoundaryMode boundaryMode = BoundaryMode::Solid;
+    StepMode stepMode = StepMode::Rects;
+    SimdPath simdPath = SimdPath::Count; // Count for the fastest supported path
+};
+
+struct BenchmarkResult
+{
+    std::string scene;
+    BoundaryMode boundaryMode;
+    StepMode stepMode;
+    SimdPath simdPath;
+    int gridWidth;
+    int gridHeight;
+    int stepCount;
+    int threadCount;
+    double stepsPerSecond;
+    double nsPerCell;
+    double nsPerActiveCell;
+    double activeCellsPerStep;
+};
+
+// Returns the comma separated list of positive integers, or an empty list if it is invalid
+// or one of the square grids it sizes is too large.
+std::vector<int> ParseSizes(const std::string& text)
+{
+    std::vector<int> sizes;
+    std::stringstream stream(text);
+    std::string item;
+
+    while (std::getline(stream, item, ','))
+    {
+        int size = 0;
+        if (!ParseInt(item, size) || size <= 0 || !GridSizeFits(size, size))
+        {
+            return {};
+        }
+        sizes.push_back(size);
+    }
+
+    return sizes;
+}
+
+// Returns false and prints the usage if an argument is not recognized.
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (argument == "--format" && hasValue)
+        {
+            options.format = argv[++i];
+        }
+        else if (argument == "--output" && hasValue)
+        {
+            options.outputPath = argv[++i];
+        }
+        else if (argument == "--sizes" && hasValue)
+        {
+            options.sizes = ParseSizes(argv[++i]);
+        }
+        else if (argument == "--steps" && hasValue)
+        {
+            if (!ParseInt(argv[++i], options.stepCount))
+            {
+                std::cerr << "--steps expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--warmup" && hasValue)
+        {
+            if (!ParseInt(argv[++i], options.warmupCount))
+            {
+                std::cerr << "--warmup expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--threads" && hasValue)
+        {
+            if (!ParseInt(argv[++i], options.threadCount))
+            {
+                std::cerr << "--threads expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--seed" && hasValue)
+        {
+            options.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (argument == "--scene" && hasValue)
+        {
+            options.sceneName = argv[++i];
+        }
+        else if (argument == "--boundary" && hasValue)
+        {
+            if (!ParseBoundaryMode(argv[++i], options.boundaryMode))
+            {
+                std::cerr << "Boundary must be solid, wrap or open" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--step-mode" && hasValue)
+        {
+            if (!ParseStepMode(argv[++i], options.stepMode))
+            {
+                std::cerr << "Step mode must be rects, active or sand-bits" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--simd" && hasValue)
+        {
+            if (!ParseSimdPath(argv[++i], options.simdPath))
+            {
+                std::cerr << "SIMD path must be scalar, sse2, avx2 or avx512" << std::endl;
+                return false;
+            }
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--format csv|json] [--output FILE] [--sizes 256,512,1024]"
+                      << " [--steps N] [--warmup N] [--threads N] [--seed N] [--scene NAME]"
+                      << " [--boundary solid|wrap|open] [--step-mode rects|active|sand-bits]"
+                      << " [--simd scalar|sse2|avx2|avx512]" << std::endl;
+            return false;
+        }
+    }
+
+    if (options.format != "csv" && options.format != "json")
+    {
+        std::cerr << "Format must be csv or json" << std::endl;
+        return false;
+    }
+
+    if (options.sizes.empty() || options.stepCount <= 0 || options.warmupCount < 0 || options.threadCount <= 0)
+    {
+        std::cerr << "Sizes, step count and thread count must be positive, and each grid hold at most " << INT_MAX << " cells border included" << std::endl;
+        return false;
+    }
+
+    if (!options.sceneName.empty() && !FindScene(options.sceneName))
+    {
+        std::cerr << "Unknown scene " << options.sceneName << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Fills a fresh grid with the scene, runs the warmup steps, then times the measured steps.
+BenchmarkResult RunScene(const Scene& scene, int size, const BenchmarkOptions& options, ThreadPool& pool)
+{
+    Grid cells(size, size);
+    cells.seed = options.seed;
+    SetBoundaryMode(cells, options.boundaryMode);
+    SetStepMode(cells, options.stepMode);
+    scene.fill(cells, size, size, options.seed);
+
+    for (int step = 0; step < options.warmupCount; step++)
+    {
+        UpdateParticleSimulation(cells, &pool);
+    }
+
+    long long activeCells = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < options.stepCount; step++)
+    {
+        activeCells += UpdateParticleSimulation(cells, &pool);
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    const double totalCells = static_cast<double>(size) * size * options.stepCount;
+
+    BenchmarkResult result;
+    result.scene = scene.name;
+    result.boundaryMode = options.boundaryMode;
+    result.stepMode = options.stepMode;
+    result.simdPath = GetSimdPath();
+    result.gridWidth = size;
+    result.gridHeight = size;
+    result.stepCount = options.stepCount;
+    result.threadCount = pool.GetThreadCount();
+    result.stepsPerSecond = options.stepCount / (elapsed.count() * 1e-9);
+    result.nsPerCell = elapsed.count() / totalCells;
+    result.nsPerActiveCell = activeCells > 0 ? elapsed.count() / activeCells : 0.0;
+    result.activeCellsPerStep = static_cast<double>(activeCells) / options.stepCount;
+    return result;
+}
+
+void WriteCsv(std::ostream& out, const std::vector<BenchmarkResult>& results)
+{
+    out << "scene,boundary,step_mode,simd,width,height,steps,threads,steps_per_second,ns_per_cell,ns_per_active_cell,active_cells_per_step\n";
+
+    for (const BenchmarkResult& result : results)
+    {
+        out << result.scene << "," << GetBoundaryModeName(result.boundaryMode) << "," << GetStepModeName(result.stepMode) << "," << GetSimdPathName(result.simdPath) << "," << result.gridWidth << "," << result.gridHeight << ","
+            << result.stepCount << "," << result.threadCount << "," << result.stepsPerSecond << ","
+            << result.nsPerCell << "," << result.nsPerActiveCell << "," << result.activeCellsPerStep << "\n";
+    }
+}
+
+void WriteJson(std::ostream& out, const std::vector<BenchmarkResult>& results)
+{
+    out << "[\n";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& result = results[i];
+        out << "  { \"scene\": \"" << result.scene << "\""
+            << ", \"boundary\": \"" << GetBoundaryModeName(result.boundaryMode) << "\""
+            << ", \"step_mode\": \"" << GetStepModeName(result.stepMode) << "\""
+            << ", \"simd\": \"" << GetSimdPathName(result.simdPath) << "\""
+            << ", \"width\": " << result.gridWidth
+            << ", \"height\": " << result.gridHeight
+            << ", \"steps\": " << result.stepCount
+            << ", \"threads\": " << result.threadCount
+            << ", \"steps_per_second\": " << result.stepsPerSecond
+            << ", \"ns_per_cell\": " << result.nsPerCell
+            << ", \"ns_per_active_cell\": " << result.nsPerActiveCell
+            << ", \"active_cells_per_step\": " << result.activeCellsPerStep
+            << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    out << "]\n";
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        return -1;
+    }
+
+    InitMaterialTable();
+
+    if (options.simdPath != SimdPath::Count && SetSimdPath(options.simdPath) != options.simdPath)
+    {
+        std::cerr << "The CPU does not support " << GetSimdPathName(options.simdPath) << ", using " << GetSimdPathName(GetSimdPath()) << std::endl;
+    }
+
+    ThreadPool pool(options.threadCount);
+    std::vector<BenchmarkResult> results;
+
+    for (const Scene& scene : GetScenes())
+    {
+        if (!options.sceneName.empty() && scene.name != options.sceneName)
+        {
+            continue;
+        }
+
+        for (int size : options.sizes)
+        {
+            // Progress goes to stderr so stdout only holds the results
+            std::cerr << scene.name << " " << size << "x" << size << std::endl;
+            results.push_back(RunScene(scene, size, options, pool));
+        }
+    }
+
+    std::ofstream file;
+    if (!options.outputPath.empty())
+    {
+        file.open(options.outputPath);
+        if (!file)
+        {
+            std::cerr << "Could not open " << options.outputPath << std::endl;
+            return -1;
+        }
+    }
+
+    std::ostream& out = options.outputPath.empty() ? std::cout : file;
+
+    if (options.format == "json")
+    {
+        WriteJson(out, results);
+    }
+    else
+    {
+        WriteCsv(out, results);
+    }
+
+    return 0;
+}
@@ -0,0 +1,191 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "config.h"
+#include "engine/grid.h"
+#include "engine/parse.h"
+
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+// Returns the text without its leading and trailing spaces.
+static std::string Trim(const std::string& text)
+{
+    const size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+    {
+        return "";
+    }
+
+    const size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+// Returns the field of the config the key names, or nullptr if the key is unknown.
+static int* FindConfigField(AppConfig& config, const std::string& key)
+{
+    if (key == "grid_width")
+    {
+        return &config.gridWidth;
+    }
+    if (key == "grid_height")
+    {
+        return &config.gridHeight;
+    }
+    if (key == "cell_size")
+    {
+        return &config.cellSize;
+    }
+    if (key == "window_width")
+    {
+        return &config.windowWidth;
+    }
+    if (key == "window_height")
+    {
+        return &config.windowHeight;
+    }
+    return nullptr;
+}
+
+// Returns false if a size is negative, or zero where it cannot be.
+static bool ConfigIsValid(const AppConfig& config)
+{
+    if (config.gridWidth < 0 || config.gridHeight < 0 || config.cellSize <= 0 ||
+        config.windowWidth <= 0 || config.windowHeight <= 0)
+    {
+        std::cout << "Grid sizes must not be negative, cell and window sizes must be positive" << std::endl;
+        return false;
+    }
+
+    if (!GridSizeFits(GetGridWidth(config), GetGridHeight(config)))
+    {
+        std::cout << "The grid is too large, it must hold at most " << INT_MAX << " cells border included" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------
+
+int GetGridWidth(const AppConfig& config)
+{
+    return config.gridWidth > 0 ? config.gridWidth : std::max(1, config.windowWidth / config.cellSize);
+}
+
+int GetGridHeight(const AppConfig& config)
+{
+    return config.gridHeight > 0 ? config.gridHeight : std::max(1, config.windowHeight / config.cellSize);
+}
+
+bool LoadConfigFile(const std::string& path, AppConfig& config)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cout << "Cannot read the config file " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        line = Trim(line);
+
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        const size_t separator = line.find('=');
+        int* field = separator != std::string::npos ? FindConfigField(config, Trim(line.substr(0, separator))) : nullptr;
+
+        if (!field)
+        {
+            std::cout << path << ":" << lineNumber << ": expected one of grid_width, grid_height, cell_size,"
+                      << " window_width or window_height followed by = and a value" << std::endl;
+            return false;
+        }
+
+        const std::string value = Trim(line.substr(separator + 1));
+        if (!ParseInt(value, *field))
+        {
+            std::cout << path << ":" << lineNumber << ": " << value << " is not a whole number" << std::endl;
+            return false;
+        }
+    }
+
+    return ConfigIsValid(config);
+}
+
+bool ParseArguments(int argc, char* argv[], AppConfig& config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (argument == "--config" && hasValue)
+        {
+            if (!LoadConfigFile(argv[++i], config))
+            {
+                return false;
+            }
+        }
+        else if (argument == "--width" && hasValue)
+        {
+            if (!ParseInt(argv[++i], config.gridWidth))
+            {
+                std::cout << "--width expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--height" && hasValue)
+        {
+            if (!ParseInt(argv[++i], config.gridHeight))
+            {
+                std::cout << "--height expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--cell-size" && hasValue)
+        {
+            if (!ParseInt(argv[++i], config.cellSize))
+            {
+                std::cout << "--cell-size expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--window-width" && hasValue)
+        {
+            if (!ParseInt(argv[++i], config.windowWidth))
+            {
+                std::cout << "--window-width expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--window-height" && hasValue)
+        {
+            if (!ParseInt(argv[++i], config.windowHeight))
+            {
+                std::cout << "--window-height expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--config FILE] [--width N] [--height N] [--cell-size N]"
+                      << " [--window-width N] [--window-height N]" << std::endl;
+            return false;
+        }
+    }
+
+    return ConfigIsValid(config);
+}
@@ -0,0 +1,37 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <string>
+
+// Sizes the application starts with. The grid is independent from the window, only the
+// part of the grid seen through the camera is drawn.
+struct AppConfig
+{
+    int gridWidth = 0; // 0 to fit the window
+    int gridHeight = 0; // 0 to fit the window
+    int cellSize = 10; // Size in pixels of a cell on screen
+    int windowWidth = 700;
+    int windowHeight = 700;
+};
+
+// Returns the width of the grid, the one that fits the window if none was given.
+int GetGridWidth(const AppConfig& config);
+
+// Returns the height of the grid, the one that fits the window if none was given.
+int GetGridHeight(const AppConfig& config);
+
+// Reads the "key = value" lines of the file into the config. Lines starting with # are
+// ignored. Keys are grid_width, grid_height, cell_size, window_width and window_height.
+// Returns false and prints the error if the file cannot be read, has an unknown key or a
+// value that is not a number.
+bool LoadConfigFile(const std::string& path, AppConfig& config);
+
+// Reads the command line into the config. --config FILE loads the file at that point, so
+// the arguments that follow it override the file. Returns false and prints the usage if
+// an argument is not recognized, or the error if a value is not a number.
+bool ParseArguments(int argc, char* argv[], AppConfig& config);
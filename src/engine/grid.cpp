@@ -0,0 +1,242 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "grid.h"
+
+#include <cstdlib>
+
+int GetCellIndexAt(const Grid& cells, int gridWidth, int x, int y)
+{
+    if (x >= 0 && x < gridWidth && y >= 0 && y < cells.height)
+    {
+        return GetCellIndex(gridWidth, x, y);
+    }
+    return -1;
+}
+
+bool GridSizeFits(int gridWidth, int gridHeight)
+{
+    return (static_cast<long long>(gridWidth) + 2) * (static_cast<long long>(gridHeight) + 2) <= INT_MAX;
+}
+
+void SetBoundaryMode(Grid& cells, BoundaryMode boundaryMode)
+{
+    cells.boundaryMode = boundaryMode;
+    cells.FillBorder();
+
+    // Particles resting against a wall may now be able to move through it
+    WakeCells(cells, 0, 0, cells.width - 1, 0);
+    WakeCells(cells, 0, cells.height - 1, cells.width - 1, cells.height - 1);
+    WakeCells(cells, 0, 0, 0, cells.height - 1);
+    WakeCells(cells, cells.width - 1, 0, cells.width - 1, cells.height - 1);
+}
+
+const char* GetBoundaryModeName(BoundaryMode boundaryMode)
+{
+    switch (boundaryMode)
+    {
+    case BoundaryMode::Wrap:
+        return "wrap";
+
+    case BoundaryMode::Open:
+        return "open";
+
+    default:
+        return "solid";
+    }
+}
+
+bool ParseBoundaryMode(const std::string& name, BoundaryMode& boundaryMode)
+{
+    for (BoundaryMode mode : { BoundaryMode::Solid, BoundaryMode::Wrap, BoundaryMode::Open })
+    {
+        if (name == GetBoundaryModeName(mode))
+        {
+            boundaryMode = mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SetStepMode(Grid& cells, StepMode stepMode)
+{
+    if (cells.stepMode == stepMode)
+    {
+        return;
+    }
+
+    cells.stepMode = stepMode;
+    for (Chunk& chunk : cells.chunks)
+    {
+        std::fill_n(chunk.currentCells, CHUNK_SIZE, 0);
+        std::fill_n(chunk.nextCells, CHUNK_SIZE, 0);
+    }
+
+    if (stepMode == StepMode::ActiveCells)
+    {
+        WakeCells(cells, 0, 0, cells.width - 1, cells.height - 1);
+    }
+}
+
+const char* GetStepModeName(StepMode stepMode)
+{
+    switch (stepMode)
+    {
+    case StepMode::ActiveCells:
+        return "active";
+
+    case StepMode::SandBits:
+        return "sand-bits";
+
+    default:
+        return "rects";
+    }
+}
+
+bool ParseStepMode(const std::string& name, StepMode& stepMode)
+{
+    for (StepMode mode : { StepMode::Rects, StepMode::ActiveCells, StepMode::SandBits })
+    {
+        if (name == GetStepModeName(mode))
+        {
+            stepMode = mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Wakes up the cells in the rect once clamped to the grid.
+static void WakeClampedCells(Grid& cells, int x0, int y0, int x1, int y1)
+{
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, cells.width - 1);
+    y1 = std::min(y1, cells.height - 1);
+
+    for (int chunkY = y0 / CHUNK_SIZE; chunkY <= y1 / CHUNK_SIZE; chunkY++)
+    {
+        for (int chunkX = x0 / CHUNK_SIZE; chunkX <= x1 / CHUNK_SIZE; chunkX++)
+        {
+            const int chunkMinX = chunkX * CHUNK_SIZE;
+            const int chunkMinY = chunkY * CHUNK_SIZE;
+            const int minX = std::max(x0, chunkMinX);
+            const int minY = std::max(y0, chunkMinY);
+            const int maxX = std::min(x1, chunkMinX + CHUNK_SIZE - 1);
+            const int maxY = std::min(y1, chunkMinY + CHUNK_SIZE - 1);
+
+            Chunk& chunk = cells.chunks[chunkY * cells.chunksX + chunkX];
+            std::lock_guard<std::mutex> lock(chunk.nextMutex);
+            chunk.next.Extend(minX, minY, maxX, maxY);
+
+            if (cells.stepMode == StepMode::ActiveCells)
+            {
+                const uint64_t rowMask = GetBitRange(minX - chunkMinX, maxX - chunkMinX);
+                for (int y = minY; y <= maxY; y++)
+                {
+                    chunk.nextCells[y - chunkMinY] |= rowMask;
+                }
+            }
+        }
+    }
+}
+
+void WakeCells(Grid& cells, int x0, int y0, int x1, int y1)
+{
+    WakeClampedCells(cells, x0, y0, x1, y1);
+
+    if (cells.boundaryMode != BoundaryMode::Wrap)
+    {
+        return;
+    }
+
+    // Rects are at most one cell outside of the grid, the overflowing column and row
+    // are the last or first ones of the grid
+    const int wrappedX = x0 < 0 ? cells.width - 1 : (x1 >= cells.width ? 0 : -1);
+    const int wrappedY = y0 < 0 ? cells.height - 1 : (y1 >= cells.height ? 0 : -1);
+
+    if (wrappedX >= 0)
+    {
+        WakeClampedCells(cells, wrappedX, y0, wrappedX, y1);
+    }
+    if (wrappedY >= 0)
+    {
+        WakeClampedCells(cells, x0, wrappedY, x1, wrappedY);
+    }
+    if (wrappedX >= 0 && wrappedY >= 0)
+    {
+        WakeClampedCells(cells, wrappedX, wrappedY, wrappedX, wrappedY);
+    }
+}
+
+void SwapCells(Grid& cells, int index1, int index2)
+{
+    // A particle moving into an empty cell flips both occupancy bits, often in one word
+    if (CellIsEmpty(cells, index1) != CellIsEmpty(cells, index2))
+    {
+        const uint64_t bit1 = 1ULL << (index1 & 63);
+        const uint64_t bit2 = 1ULL << (index2 & 63);
+        if ((index1 >> 6) == (index2 >> 6))
+        {
+            cells.occupancy[index1 >> 6].fetch_xor(bit1 | bit2, std::memory_order_relaxed);
+        }
+        else
+        {
+            cells.occupancy[index1 >> 6].fetch_xor(bit1, std::memory_order_relaxed);
+            cells.occupancy[index2 >> 6].fetch_xor(bit2, std::memory_order_relaxed);
+        }
+    }
+
+    std::swap(cells.materials[index1], cells.materials[index2]);
+    std::swap(cells.lifeTimes[index1], cells.lifeTimes[index2]);
+    std::swap(cells.flags[index1], cells.flags[index2]);
+
+    // Both cells and everything next to them may now be able to move. The cells are far
+    // apart when a particle wraps around the grid, and one of them is in the border when a
+    // particle leaves an open grid, the border is never drawn.
+    const int x1 = GetCellX(cells, index1);
+    const int y1 = GetCellY(cells, index1);
+    const int x2 = GetCellX(cells, index2);
+    const int y2 = GetCellY(cells, index2);
+    MarkCellChanged(cells, std::max(0, std::min(x1, cells.width - 1)), std::max(0, std::min(y1, cells.height - 1)));
+    MarkCellChanged(cells, std::max(0, std::min(x2, cells.width - 1)), std::max(0, std::min(y2, cells.height - 1)));
+
+    if (std::abs(x1 - x2) <= 1 && std::abs(y1 - y2) <= 1)
+    {
+        WakeCells(cells, std::min(x1, x2) - 1, std::min(y1, y2) - 1, std::max(x1, x2) + 1, std::max(y1, y2) + 1);
+    }
+    else
+    {
+        WakeCells(cells, x1 - 1, y1 - 1, x1 + 1, y1 + 1);
+        WakeCells(cells, x2 - 1, y2 - 1, x2 + 1, y2 + 1);
+    }
+}
+
+// The occupancy is read a word at a time, so a run of empty cells costs one test per 64
+// cells.
+int FindNextNonEmpty(const Grid& cells, int start, int end)
+{
+    if (start >= end)
+    {
+        return end;
+    }
+
+    const int lastWord = (end - 1) >> 6;
+    int word = start >> 6;
+    uint64_t bits = cells.occupancy[word].load(std::memory_order_relaxed) & (~0ULL << (start & 63));
+
+    while (bits == 0)
+    {
+        if (++word > lastWord)
+        {
+            return end;
+        }
+        bits = cells.occupancy[word].load(std::memory_order_relaxed);
+    }
+
+    return std::min(end, word * 64 + CountTrailingZeros(bits));
+}
@@ -0,0 +1,361 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <climits>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "materials.h"
+
+enum CellFlags : uint8_t
+{
+    // The particle moved this frame and must not be updated again if it ended up in a cell
+    // visited later. Set with MarkCellUpdated, which lists the cell to clear it next frame.
+    CELL_FLAG_UPDATED = 1 << 0
+};
+
+static_assert(MATERIAL_COUNT <= 256, "Material types must fit in the 8 bits of a cell");
+
+constexpr int CHUNK_SIZE = 64;
+static_assert(CHUNK_SIZE <= 64, "A row of a chunk must fit in the 64 bits of a mask");
+
+// Returns the index of the lowest set bit of the mask, which must not be 0.
+inline int CountTrailingZeros(uint64_t mask)
+{
+#if defined(_MSC_VER) && defined(_M_IX86)
+    // No 64 bit scan on 32 bit targets, the halves are scanned one after the other
+    unsigned long bit;
+    if (_BitScanForward(&bit, static_cast<unsigned long>(mask)))
+    {
+        return static_cast<int>(bit);
+    }
+    _BitScanForward(&bit, static_cast<unsigned long>(mask >> 32));
+    return static_cast<int>(bit) + 32;
+#elif defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward64(&bit, mask);
+    return static_cast<int>(bit);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+// Returns the number of bits above the highest set bit of the mask, which must not be 0.
+inline int CountLeadingZeros(uint64_t mask)
+{
+#if defined(_MSC_VER) && defined(_M_IX86)
+    unsigned long bit;
+    if (_BitScanReverse(&bit, static_cast<unsigned long>(mask >> 32)))
+    {
+        return 31 - static_cast<int>(bit);
+    }
+    _BitScanReverse(&bit, static_cast<unsigned long>(mask));
+    return 63 - static_cast<int>(bit);
+#elif defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanReverse64(&bit, mask);
+    return 63 - static_cast<int>(bit);
+#else
+    return __builtin_clzll(mask);
+#endif
+}
+
+// Returns the number of set bits of the mask.
+inline int CountSetBits(uint64_t mask)
+{
+    return static_cast<int>(std::bitset<64>(mask).count());
+}
+
+// Returns the mask with the bits from first to last set, both in [0, 64).
+inline uint64_t GetBitRange(int first, int last)
+{
+    return (~0ULL >> (63 - last)) & (~0ULL << first);
+}
+
+// What happens to particles reaching the edges of the grid.
+enum class BoundaryMode
+{
+    Solid, // The edges are walls
+    Wrap, // A particle leaving through an edge comes back through the opposite one
+    Open // A particle leaving through an edge is deleted
+};
+
+// Which cells of the awake chunks a step visits.
+enum class StepMode
+{
+    Rects, // Every cell of the dirty rects
+    ActiveCells, // Only the particles listed as active, so empty space costs nothing
+    SandBits // The dirty rects, with the bit sliced kernel where they hold only sand
+};
+
+// Rect of cells in grid coordinates, bounds included. The rect is empty when minX > maxX.
+struct DirtyRect
+{
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+
+    DirtyRect()
+        : minX(INT_MAX)
+        , minY(INT_MAX)
+        , maxX(INT_MIN)
+        , maxY(INT_MIN)
+    {
+    }
+
+    bool IsEmpty() const
+    {
+        return minX > maxX;
+    }
+
+    void Extend(int x0, int y0, int x1, int y1)
+    {
+        minX = std::min(minX, x0);
+        minY = std::min(minY, y0);
+        maxX = std::max(maxX, x1);
+        maxY = std::max(maxY, y1);
+    }
+};
+
+// A square area of the grid that is only updated while awake, that is while something
+// moved in it or next to it during the previous frame.
+struct Chunk
+{
+    DirtyRect current; // Cells to update this frame
+    DirtyRect next; // Cells to update next frame, grown as particles move
+    uint64_t currentCells[CHUNK_SIZE] = {}; // Bit x of row y is set for the cells to update this frame, when stepping the active cells
+    uint64_t nextCells[CHUNK_SIZE] = {}; // Same for the next frame, chunk coordinates
+    std::vector<int> updatedCells; // Cells the particles of the chunk moved into this frame, flagged as updated
+    std::mutex nextMutex; // Chunks updated in parallel may wake the same neighbor
+    std::atomic<bool> pixelsChanged{ true }; // A cell changed since the chunk was last copied for drawing
+
+    bool IsAwake() const
+    {
+        return !current.IsEmpty();
+    }
+};
+
+// The grid is stored as parallel planes, one value per cell in each, so the simulation
+// loop only streams the dense material plane and the other planes are touched on demand.
+// The planes are surrounded by a one cell border of boundary material, so the neighbors
+// of any cell inside the grid can be read without bounds checks.
+struct Grid
+{
+    int width;
+    int height;
+    int stride; // Distance between two rows in the planes, border included
+
+    std::vector<uint8_t> materials; // MaterialType of each cell
+    std::vector<uint16_t> lifeTimes; // Lifetime in frames of each cell
+    std::vector<uint8_t> flags; // CellFlags of each cell
+    std::vector<std::atomic<uint64_t>> occupancy; // One bit per cell, set unless the cell is empty, so scans skip 64 empty cells at once
+
+    int chunksX;
+    int chunksY;
+    std::vector<Chunk> chunks;
+
+    uint32_t seed = 0; // Every random decision derives from the seed, see random.h
+    uint32_t frame = 0; // Number of simulation steps so far
+    uint32_t revealCount = 0; // Number of brush strokes so far
+
+    BoundaryMode boundaryMode = BoundaryMode::Solid; // Changed with SetBoundaryMode
+    StepMode stepMode = StepMode::Rects; // Changed with SetStepMode
+
+    Grid(int gridWidth, int gridHeight)
+        : width(gridWidth)
+        , height(gridHeight)
+        , stride(gridWidth + 2)
+        , materials(stride * (gridHeight + 2), static_cast<uint8_t>(MaterialType::None))
+        , lifeTimes(stride * (gridHeight + 2), 0)
+        , flags(stride * (gridHeight + 2), 0)
+        , occupancy((stride * (gridHeight + 2) + 63) / 64 + 1) // A spare word, so 64 bits can be read from any cell
+        , chunksX((gridWidth + CHUNK_SIZE - 1) / CHUNK_SIZE)
+        , chunksY((gridHeight + CHUNK_SIZE - 1) / CHUNK_SIZE)
+        , chunks(chunksX * chunksY)
+    {
+        FillBorder();
+    }
+
+    // Surrounds the grid with boundary cells, or void cells when the grid is open. Called
+    // after every step of an open grid to delete the particles that moved into the border.
+    void FillBorder()
+    {
+        const uint8_t border = static_cast<uint8_t>(boundaryMode == BoundaryMode::Open ? MaterialType::Void : MaterialType::Boundary);
+        const int lastRow = (height + 1) * stride;
+
+        std::fill(materials.begin(), materials.begin() + stride, border);
+        std::fill(materials.begin() + lastRow, materials.end(), border);
+        for (int y = 1; y <= height; y++)
+        {
+            materials[y * stride] = border;
+            materials[y * stride + width + 1] = border;
+        }
+
+        // Both border materials count as occupied
+        for (int index = 0; index < stride; index++)
+        {
+            SetOccupied(index);
+            SetOccupied(lastRow + index);
+        }
+        for (int y = 1; y <= height; y++)
+        {
+            SetOccupied(y * stride);
+            SetOccupied(y * stride + width + 1);
+        }
+    }
+
+    // Sets the occupancy bit of the cell at index. Chunks updated in parallel may share a
+    // word of the occupancy, so its bits are only changed atomically.
+    void SetOccupied(int index)
+    {
+        occupancy[index >> 6].fetch_or(1ULL << (index & 63), std::memory_order_relaxed);
+    }
+
+    int Size() const
+    {
+        return static_cast<int>(materials.size());
+    }
+};
+
+constexpr int BYTES_PER_CELL = sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint8_t); // Plus a bit of occupancy
+
+// Returns the index in the list of the cell located at x and y. The border is at -1 and
+// at width or height, so x and y may be one cell outside of the grid.
+inline int GetCellIndex(int gridWidth, int x, int y)
+{
+    return (y + 1) * (gridWidth + 2) + x + 1;
+}
+
+// Returns the column of the cell at index.
+inline int GetCellX(const Grid& cells, int index)
+{
+    return index % cells.stride - 1;
+}
+
+// Returns the row of the cell at index.
+inline int GetCellY(const Grid& cells, int index)
+{
+    return index / cells.stride - 1;
+}
+
+// Returns the material type of the cell at index.
+inline MaterialType GetCellMaterial(const Grid& cells, int index)
+{
+    return static_cast<MaterialType>(cells.materials[index]);
+}
+
+// Returns wether the cell at index is empty or not.
+inline bool CellIsEmpty(const Grid& cells, int index)
+{
+    return !((cells.occupancy[index >> 6].load(std::memory_order_relaxed) >> (index & 63)) & 1);
+}
+
+// Returns the occupancy of the 64 cells from index, one bit per cell.
+inline uint64_t LoadOccupancy(const Grid& cells, int index)
+{
+    const int word = index >> 6;
+    const int shift = index & 63;
+
+    const uint64_t low = cells.occupancy[word].load(std::memory_order_relaxed);
+    if (shift == 0)
+    {
+        return low;
+    }
+    return (low >> shift) | (cells.occupancy[word + 1].load(std::memory_order_relaxed) << (64 - shift));
+}
+
+// Changes the material of the cell at index, and its occupancy bit if it gets filled or
+// emptied. The rest of the cell is left as it was.
+inline void WriteCellMaterial(Grid& cells, int index, MaterialType materialType)
+{
+    if ((materialType == MaterialType::None) != CellIsEmpty(cells, index))
+    {
+        cells.occupancy[index >> 6].fetch_xor(1ULL << (index & 63), std::memory_order_relaxed);
+    }
+    cells.materials[index] = static_cast<uint8_t>(materialType);
+}
+
+// Returns the chunk holding the cell at x and y.
+inline Chunk& GetChunkAt(Grid& cells, int x, int y)
+{
+    return cells.chunks[(y / CHUNK_SIZE) * cells.chunksX + x / CHUNK_SIZE];
+}
+
+// Flags the chunk holding the cell at x and y so its pixels get uploaded again.
+inline void MarkCellChanged(Grid& cells, int x, int y)
+{
+    GetChunkAt(cells, x, y).pixelsChanged.store(true, std::memory_order_relaxed);
+}
+
+// Flags the particle the chunk just moved into the cell at index as updated. The cell is
+// listed in the chunk, only written by the thread updating it, to clear the flag before
+// the next step.
+inline void MarkCellUpdated(Grid& cells, Chunk& chunk, int index)
+{
+    cells.flags[index] |= CELL_FLAG_UPDATED;
+    chunk.updatedCells.push_back(index);
+}
+
+// Replaces the particle at index by a fresh particle of the material type.
+inline void SetCellMaterial(Grid& cells, int index, MaterialType materialType)
+{
+    WriteCellMaterial(cells, index, materialType);
+    cells.lifeTimes[index] = 0;
+    cells.flags[index] = 0;
+
+    MarkCellChanged(cells, GetCellX(cells, index), GetCellY(cells, index));
+}
+
+// Returns the index of the cell located at x and y in the grid, or -1 if it is outside.
+// Only needed for positions that do not come from a neighbor of a cell, like the brush.
+int GetCellIndexAt(const Grid& cells, int gridWidth, int x, int y);
+
+// Returns true if the cells of a grid of that size, border included, can be indexed with
+// an int.
+bool GridSizeFits(int gridWidth, int gridHeight);
+
+// Changes what happens on the edges of the grid and wakes the cells along them.
+void SetBoundaryMode(Grid& cells, BoundaryMode boundaryMode);
+
+// Returns the name of the boundary mode, as accepted by ParseBoundaryMode.
+const char* GetBoundaryModeName(BoundaryMode boundaryMode);
+
+// Returns false if the name is not one of solid, wrap or open.
+bool ParseBoundaryMode(const std::string& name, BoundaryMode& boundaryMode);
+
+// Changes which cells a step visits. Switching to the active cells lists every cell of
+// the grid, the ones that cannot move drop out of the lists after a step.
+void SetStepMode(Grid& cells, StepMode stepMode);
+
+// Returns the name of the step mode, as accepted by ParseStepMode.
+const char* GetStepModeName(StepMode stepMode);
+
+// Returns false if the name is not one of rects, active or sand-bits.
+bool ParseStepMode(const std::string& name, StepMode& stepMode);
+
+// Wakes up the cells in the rect, bounds included, so they get updated next frame.
+// The rect is split among the chunks it overlaps, and its cells are listed as active
+// while stepping the active cells. On a wrapping grid, the part of the rect outside of
+// the grid wakes the cells on the opposite edge.
+void WakeCells(Grid& cells, int x0, int y0, int x1, int y1);
+
+// The particle at index1 goes to index2 and the one at index2 goes to index1.
+void SwapCells(Grid& cells, int index1, int index2);
+
+// Returns the index of the first non empty cell in [start, end) of the planes, or end.
+int FindNextNonEmpty(const Grid& cells, int start, int end);
@@ -0,0 +1,117 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "materials.h"
+
+#include <array>
+#include <algorithm>
+
+// One entry per material, filled once at startup by InitMaterialTable.
+static std::array<SpreadRules, MATERIAL_COUNT> materialTable;
+
+// ARGB8888 pixel each material is drawn with, filled once at startup by InitMaterialTable.
+static std::array<uint32_t, MATERIAL_COUNT> materialPixels;
+
+MaterialInteraction materialInteractions[MATERIAL_COUNT][MATERIAL_COUNT];
+
+// --------------------------------------------------------------------------------------------
+
+SpreadRules GetParticleSpreadRules(MaterialType materialType)
+{
+    SpreadRules rules;
+    switch (materialType)
+    {
+    case MaterialType::None:
+        rules = { 1, { MaterialType::None }, { { MaterialType::None, { 0, 0, 0, 255 } } } };
+        break;
+
+    case MaterialType::Sand:
+        rules = { 1, { MaterialType::None, MaterialType::Water }, { { MaterialType::None, { 255, 255, 0, 255 } }, { MaterialType::Water, { 255, 255, 0, 255 } } } };
+        break;
+
+    case MaterialType::Water:
+        rules = { 1, { MaterialType::None, MaterialType::Lava }, { { MaterialType::None, { 0, 0, 255, 255 } }, { MaterialType::Lava, { 230, 230, 0, 255 } } } };
+        break;
+
+    case MaterialType::Lava:
+        rules = { 1, { MaterialType::None }, { { MaterialType::None, { 255, 0, 0, 255 } } } };
+        break;
+
+    case MaterialType::Acid:
+        rules = { 1, { MaterialType::None }, { { MaterialType::None, { 88, 212, 0, 255 } } } };
+        break;
+
+    case MaterialType::ToxicGas:
+        rules = { 1, { MaterialType::None }, { { MaterialType::None, { 220, 220, 220, 255 } } } };
+        break;
+
+    case MaterialType::Boundary:
+    case MaterialType::Void:
+        rules = { 0, {}, { { MaterialType::None, { 0, 0, 0, 255 } } } };
+        break;
+
+    default:
+        break;
+    }
+
+    return rules;
+}
+
+void InitMaterialTable()
+{
+    for (int i = 0; i < MATERIAL_COUNT; i++)
+    {
+        materialTable[i] = GetParticleSpreadRules(static_cast<MaterialType>(i));
+    }
+
+    // Flatten the rules so any pair is answered by a single load
+    for (int particle = 0; particle < MATERIAL_COUNT; particle++)
+    {
+        const SpreadRules& rules = materialTable[particle];
+
+        for (int target = 0; target < MATERIAL_COUNT; target++)
+        {
+            const MaterialType targetType = static_cast<MaterialType>(target);
+            MaterialInteraction& interaction = materialInteractions[particle][target];
+
+            // Any particle may move into an empty cell, or out of the grid through the void,
+            // which leaves an empty cell behind
+            const bool listed = std::find(rules.canReplace.begin(), rules.canReplace.end(), targetType) != rules.canReplace.end();
+            const bool isVoid = targetType == MaterialType::Void;
+            interaction.canReplace = (listed || targetType == MaterialType::None || isVoid) ? 1 : 0;
+            interaction.becomes = static_cast<uint8_t>(isVoid ? MaterialType::None : targetType);
+            interaction.padding[0] = 0;
+            interaction.padding[1] = 0;
+
+            auto it = rules.contactColors.find(targetType);
+            interaction.contactColor = it != rules.contactColors.end() ? it->second : Color{ 0, 0, 0, 255 };
+        }
+    }
+
+    for (int i = 0; i < MATERIAL_COUNT; i++)
+    {
+        const Color color = GetMaterialColor(static_cast<MaterialType>(i));
+        materialPixels[i] = (static_cast<uint32_t>(color.a) << 24) | (static_cast<uint32_t>(color.r) << 16) |
+                            (static_cast<uint32_t>(color.g) << 8) | static_cast<uint32_t>(color.b);
+    }
+}
+
+const SpreadRules& GetMaterialSpreadRules(MaterialType materialType)
+{
+    return materialTable[static_cast<int>(materialType)];
+}
+
+const uint32_t* GetMaterialPalette()
+{
+    return materialPixels.data();
+}
+
+// --------------------------------------------------------------------------------------------
+
+Color GetMaterialColor(MaterialType materialType)
+{
+    return GetParticleColorOnCollision(materialType, MaterialType::None);
+}
@@ -0,0 +1,88 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+enum class MaterialType
+{
+    None, // Used to represent an empty cell/particle
+    Sand,
+    Water,
+    Lava,
+    Acid,
+    ToxicGas,
+    Boundary, // Immovable border around the grid, never placed by the user
+    Void, // Border around an open grid, particles moving into it are deleted
+    Count // Number of materials, not a material itself
+};
+
+constexpr int MATERIAL_COUNT = static_cast<int>(MaterialType::Count);
+
+// Rgba color, laid out like SDL_Color so the engine does not depend on SDL.
+struct Color
+{
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+};
+
+struct SpreadRules
+{
+    int spreadSpeed;
+    std::vector<MaterialType> canReplace;
+    std::unordered_map<MaterialType, Color> contactColors;
+};
+
+// Outcome of a particle of one material meeting a cell of another, see GetMaterialInteraction.
+struct MaterialInteraction
+{
+    uint8_t canReplace; // 1 if the particle may take the place of the target
+    uint8_t becomes; // MaterialType the target turns into once it has been replaced
+    uint8_t padding[2];
+    Color contactColor; // Color the particle takes on contact with the target
+};
+
+static_assert(sizeof(MaterialInteraction) == 8, "Interactions must stay small to keep the table cache friendly");
+
+// Every pair of materials, indexed by [particle][target], built once by InitMaterialTable.
+extern MaterialInteraction materialInteractions[MATERIAL_COUNT][MATERIAL_COUNT];
+
+SpreadRules GetParticleSpreadRules(MaterialType materialType);
+
+// Fills the material table, must be called before any particle is updated.
+void InitMaterialTable();
+
+// Returns the spread rules shared by every particle of the material type.
+const SpreadRules& GetMaterialSpreadRules(MaterialType materialType);
+
+// Returns the ARGB8888 pixel of every material, indexed by material type.
+const uint32_t* GetMaterialPalette();
+
+// Returns the rgb color a particle of the material type is drawn with.
+Color GetMaterialColor(MaterialType materialType);
+
+// Returns what happens when a particle of the material meets a cell of the target material.
+inline const MaterialInteraction& GetMaterialInteraction(MaterialType particle, MaterialType target)
+{
+    return materialInteractions[static_cast<int>(particle)][static_cast<int>(target)];
+}
+
+// Returns a new rgb color that the particle should take when it collides with the target.
+inline Color GetParticleColorOnCollision(MaterialType particle, MaterialType target)
+{
+    return GetMaterialInteraction(particle, target).contactColor;
+}
+
+// Returns true if the particle is allowed to replace the target material type.
+inline bool ParticleCanReplace(MaterialType particle, MaterialType target)
+{
+    return GetMaterialInteraction(particle, target).canReplace != 0;
+}
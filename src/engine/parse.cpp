@@ -0,0 +1,26 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "parse.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+bool ParseInt(const std::string& text, int& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    const long parsed = std::strtol(text.c_str(), &end, 10);
+
+    if (text.empty() || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX)
+    {
+        return false;
+    }
+
+    value = static_cast<int>(parsed);
+    return true;
+}
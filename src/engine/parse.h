@@ -0,0 +1,12 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <string>
+
+// Returns false if the text is not a whole number that fits in an int.
+bool ParseInt(const std::string& text, int& value);
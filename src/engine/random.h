@@ -0,0 +1,47 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+// Counter based random numbers: every value is a hash of the seed, the frame and the
+// cell coordinates, so there is no engine state to share between threads and a run
+// is fully reproducible from its seed.
+
+// Scrambles the bits of the value, see "Prospecting for Hash Functions" by C. Wellons.
+inline uint32_t MixBits(uint32_t value)
+{
+    value ^= value >> 16;
+    value *= 0x7FEB352Du;
+    value ^= value >> 15;
+    value *= 0x846CA68Bu;
+    value ^= value >> 16;
+    return value;
+}
+
+// Returns a random 32 bits value, always the same for the same inputs.
+inline uint32_t HashRandom(uint32_t seed, uint32_t frame, uint32_t x, uint32_t y)
+{
+    uint32_t hash = MixBits(seed + 0x9E3779B9u);
+    hash = MixBits(hash ^ frame);
+    hash = MixBits(hash ^ x);
+    return MixBits(hash ^ y);
+}
+
+// Returns a random integer in [0, count) from a random 32 bits value.
+inline uint32_t RandomBelow(uint32_t random, uint32_t count)
+{
+    return static_cast<uint32_t>((static_cast<uint64_t>(random) * count) >> 32);
+}
+
+// Returns a random float in [min, max] from a random 32 bits value.
+inline float RandomFloat(uint32_t random, float min, float max)
+{
+    // The upper 24 bits fit exactly in the mantissa of a float
+    const float unit = static_cast<float>(random >> 8) * (1.0f / 16777215.0f);
+    return min + (max - min) * unit;
+}
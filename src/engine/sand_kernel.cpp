@@ -0,0 +1,156 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "sand_kernel.h"
+#include "simd.h"
+
+static_assert(static_cast<int>(MaterialType::None) == 0 && static_cast<int>(MaterialType::Sand) == 1, "Sand areas are found by testing the material bytes for 0 or 1");
+static_assert(CELL_FLAG_UPDATED == 1, "Updated flags are gathered from the lowest bit of each flag byte");
+
+// Flips the occupancy of the cells from index whose bit is set.
+static void ToggleOccupancy(Grid& cells, int index, uint64_t bits)
+{
+    const int word = index >> 6;
+    const int shift = index & 63;
+
+    if (bits << shift)
+    {
+        cells.occupancy[word].fetch_xor(bits << shift, std::memory_order_relaxed);
+    }
+    if (shift != 0 && (bits >> (64 - shift)))
+    {
+        cells.occupancy[word + 1].fetch_xor(bits >> (64 - shift), std::memory_order_relaxed);
+    }
+}
+
+// Returns the updated flags of the count cells from index, one bit per cell.
+static uint64_t LoadUpdatedBits(const Grid& cells, int index, int count)
+{
+    return PackLowestBits(&cells.flags[index], count);
+}
+
+// Flags every chunk holding one of the cells from minX to maxX of row y so their pixels
+// get uploaded again.
+static void MarkRowChanged(Grid& cells, int minX, int maxX, int y)
+{
+    for (int x = minX - minX % CHUNK_SIZE; x <= maxX; x += CHUNK_SIZE)
+    {
+        MarkCellChanged(cells, x, y);
+    }
+}
+
+// Moves the grain at index into the empty cell at targetIndex, flagged as updated in the
+// chunk. The occupancy is updated by the caller, a whole row at once.
+static void MoveGrain(Grid& cells, Chunk& chunk, int index, int targetIndex)
+{
+    cells.materials[targetIndex] = cells.materials[index];
+    cells.materials[index] = static_cast<uint8_t>(MaterialType::None);
+    std::swap(cells.lifeTimes[index], cells.lifeTimes[targetIndex]);
+    std::swap(cells.flags[index], cells.flags[targetIndex]);
+
+    cells.flags[index] &= ~CELL_FLAG_UPDATED;
+    MarkCellUpdated(cells, chunk, targetIndex);
+}
+
+// --------------------------------------------------------------------------------------------
+
+bool RectHoldsOnlySand(const Grid& cells, int gridWidth, const DirtyRect& rect)
+{
+    // Anywhere but on a solid grid, the cells past the edges are not plain walls
+    if (cells.boundaryMode != BoundaryMode::Solid && (rect.minX < 1 || rect.maxX > gridWidth - 2 || rect.maxY > cells.height - 2))
+    {
+        return false;
+    }
+
+    const int minX = std::max(rect.minX - 1, 0);
+    const int maxX = std::min(rect.maxX + 1, gridWidth - 1);
+    const int maxY = std::min(rect.maxY + 1, cells.height - 1);
+    const int count = maxX - minX + 1;
+
+    for (int y = rect.minY; y <= maxY; y++)
+    {
+        if (!BytesAtMost(&cells.materials[GetCellIndex(gridWidth, minX, y)], count, static_cast<uint8_t>(MaterialType::Sand)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int UpdateSandInRect(Grid& cells, int gridWidth, const DirtyRect& rect)
+{
+    Chunk& chunk = GetChunkAt(cells, rect.minX, rect.minY);
+    const int stride = cells.stride;
+    const int count = rect.maxX - rect.minX + 1;
+    const uint64_t rowMask = GetBitRange(0, count - 1);
+
+    int updatedCount = 0;
+
+    for (int y = rect.maxY; y >= rect.minY; y--)
+    {
+        const int rowIndex = GetCellIndex(gridWidth, rect.minX, y);
+        const int belowIndex = rowIndex + stride;
+
+        // Bit x stands for the column minX + x, of this row or of the cells below it
+        const uint64_t grains = LoadOccupancy(cells, rowIndex) & rowMask & ~LoadUpdatedBits(cells, rowIndex, count);
+        if (grains == 0)
+        {
+            continue;
+        }
+
+        const uint64_t freeBelow = ~LoadOccupancy(cells, belowIndex);
+        const uint64_t freeBelowLeft = ~LoadOccupancy(cells, belowIndex - 1);
+        const uint64_t freeBelowRight = ~LoadOccupancy(cells, belowIndex + 1);
+
+        // Each move only takes the cells the previous ones left free
+        const uint64_t fall = grains & freeBelow;
+        const uint64_t fallLeft = grains & ~fall & freeBelowLeft & ~(fall << 1);
+        const uint64_t fallRight = grains & ~fall & ~fallLeft & freeBelowRight & ~(fall >> 1) & ~(fallLeft >> 2);
+        const uint64_t moved = fall | fallLeft | fallRight;
+
+        updatedCount += CountSetBits(grains);
+
+        if (moved == 0)
+        {
+            continue;
+        }
+
+        // Only the cells moved into get flagged, a grain staying in place is not visited again
+        for (uint64_t bits = fall; bits != 0; bits &= bits - 1)
+        {
+            const int index = rowIndex + CountTrailingZeros(bits);
+            MoveGrain(cells, chunk, index, index + stride);
+        }
+        for (uint64_t bits = fallLeft; bits != 0; bits &= bits - 1)
+        {
+            const int index = rowIndex + CountTrailingZeros(bits);
+            MoveGrain(cells, chunk, index, index + stride - 1);
+        }
+        for (uint64_t bits = fallRight; bits != 0; bits &= bits - 1)
+        {
+            const int index = rowIndex + CountTrailingZeros(bits);
+            MoveGrain(cells, chunk, index, index + stride + 1);
+        }
+
+        ToggleOccupancy(cells, rowIndex, moved);
+        ToggleOccupancy(cells, belowIndex, fall);
+        ToggleOccupancy(cells, belowIndex - 1, fallLeft);
+        ToggleOccupancy(cells, belowIndex + 1, fallRight);
+
+        // A single wake and redraw for the row, covering what SwapCells would for each grain
+        const int firstX = rect.minX + CountTrailingZeros(moved);
+        const int lastX = rect.minX + 63 - CountLeadingZeros(moved);
+        WakeCells(cells, firstX - 2, y - 1, lastX + 2, y + 2);
+
+        const int changedMinX = std::max(firstX - 1, 0);
+        const int changedMaxX = std::min(lastX + 1, gridWidth - 1);
+        MarkRowChanged(cells, changedMinX, changedMaxX, y);
+        MarkRowChanged(cells, changedMinX, changedMaxX, y + 1);
+    }
+
+    return updatedCount;
+}
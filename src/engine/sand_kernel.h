@@ -0,0 +1,28 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include "grid.h"
+
+// Bit sliced kernel for areas of the grid holding nothing but sand. A row of a dirty rect
+// is at most one chunk wide, so its moves are computed at once from the occupancy bits,
+// one bit per column.
+//
+// The moves are the ones of UpdateSolid, but a row resolves its conflicts all at once
+// rather than from left to right: every grain that can fall straight down does, then the
+// others try below left, then below right. Runs stay reproducible, they just differ from
+// the per cell kernel.
+
+// Returns true if the rect, its row below and its columns on each side hold only sand and
+// empty cells, so UpdateSandInRect gives the right moves. On a grid that is not solid, the
+// rect must also stay clear of the edges.
+bool RectHoldsOnlySand(const Grid& cells, int gridWidth, const DirtyRect& rect);
+
+// Updates the sand grains located in the rect, bounds included, from the bottom row to the
+// top one. The rect lies in a single chunk, which lists the grains it moves. Grains already
+// updated this frame are skipped. Returns the number of grains updated.
+int UpdateSandInRect(Grid& cells, int gridWidth, const DirtyRect& rect);
@@ -0,0 +1,115 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "scenes.h"
+#include "random.h"
+
+// The cells are drawn from HashRandom rather than the standard distributions, whose output
+// differs between standard libraries, so a seed gives the same scene on every platform.
+
+// Returns the random value of the cell for the seed.
+static uint32_t GetSceneRandom(unsigned int seed, int x, int y)
+{
+    return HashRandom(seed, 0, static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+}
+
+// Sets every cell of the rect, right and bottom bounds excluded, to the material with
+// the given probability.
+static void FillRect(Grid& cells, int gridWidth, int x0, int y0, int x1, int y1, MaterialType materialType, double density, unsigned int seed)
+{
+    // Compared on the 32 bits of the value, a density of 1 fills every cell
+    const double threshold = density * 4294967296.0;
+
+    for (int y = y0; y < y1; y++)
+    {
+        for (int x = x0; x < x1; x++)
+        {
+            if (GetSceneRandom(seed, x, y) < threshold)
+            {
+                SetCellMaterial(cells, GetCellIndex(gridWidth, x, y), materialType);
+            }
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------------------
+
+void FillSandAndWaterScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed)
+{
+    for (int y = 0; y < gridHeight / 2; y++)
+    {
+        for (int x = 0; x < gridWidth; x++)
+        {
+            const uint32_t value = RandomBelow(GetSceneRandom(seed, x, y), 4);
+            if (value != 0)
+            {
+                SetCellMaterial(cells, GetCellIndex(gridWidth, x, y), value == 1 ? MaterialType::Water : MaterialType::Sand);
+            }
+        }
+    }
+
+    WakeCells(cells, 0, 0, gridWidth - 1, gridHeight - 1);
+}
+
+void FillSandAvalancheScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed)
+{
+    FillRect(cells, gridWidth, 0, 0, gridWidth / 2, gridHeight / 2, MaterialType::Sand, 1.0, seed);
+    WakeCells(cells, 0, 0, gridWidth - 1, gridHeight - 1);
+}
+
+void FillWaterBasinScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed)
+{
+    FillRect(cells, gridWidth, 0, gridHeight / 2, gridWidth, gridHeight, MaterialType::Water, 0.9, seed);
+    WakeCells(cells, 0, 0, gridWidth - 1, gridHeight - 1);
+}
+
+void FillGasCloudScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed)
+{
+    FillRect(cells, gridWidth, gridWidth / 4, gridHeight / 4, gridWidth * 3 / 4, gridHeight * 3 / 4, MaterialType::ToxicGas, 0.5, seed);
+    WakeCells(cells, 0, 0, gridWidth - 1, gridHeight - 1);
+}
+
+void FillLavaMeetsWaterScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed)
+{
+    FillRect(cells, gridWidth, 0, 0, gridWidth / 2, gridHeight / 2, MaterialType::Lava, 0.8, seed);
+    FillRect(cells, gridWidth, gridWidth / 2, 0, gridWidth, gridHeight / 2, MaterialType::Water, 0.8, seed);
+    WakeCells(cells, 0, 0, gridWidth - 1, gridHeight - 1);
+}
+
+void FillSparseScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed)
+{
+    FillRect(cells, gridWidth, 0, 0, gridWidth, gridHeight, MaterialType::Sand, 0.005, seed);
+    WakeCells(cells, 0, 0, gridWidth - 1, gridHeight - 1);
+}
+
+// --------------------------------------------------------------------------------------------
+
+const std::vector<Scene>& GetScenes()
+{
+    static const std::vector<Scene> scenes = {
+        { "sand-and-water", FillSandAndWaterScene },
+        { "sand-avalanche", FillSandAvalancheScene },
+        { "water-basin", FillWaterBasinScene },
+        { "gas-cloud", FillGasCloudScene },
+        { "lava-meets-water", FillLavaMeetsWaterScene },
+        { "sparse", FillSparseScene }
+    };
+
+    return scenes;
+}
+
+const Scene* FindScene(const std::string& name)
+{
+    for (const Scene& scene : GetScenes())
+    {
+        if (scene.name == name)
+        {
+            return &scene;
+        }
+    }
+
+    return nullptr;
+}
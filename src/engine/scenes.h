@@ -0,0 +1,46 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "grid.h"
+
+// Fills an empty grid with a reproducible starting state, the same seed always giving the same grid.
+using SceneFillFunction = void (*)(Grid& cells, int gridWidth, int gridHeight, unsigned int seed);
+
+struct Scene
+{
+    std::string name;
+    SceneFillFunction fill;
+};
+
+// Fills the upper half of the grid with a reproducible mix of sand and water, leaving
+// a quarter of the cells empty so the particles keep moving for many frames.
+void FillSandAndWaterScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed);
+
+// Piles sand in the upper left quarter of the grid, which then collapses over the floor.
+void FillSandAvalancheScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed);
+
+// Fills the lower half of the grid with water full of holes, which levels out and settles.
+void FillWaterBasinScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed);
+
+// Fills the middle of the grid with a cloud of toxic gas, which never settles.
+void FillGasCloudScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed);
+
+// Pours lava on the left half and water on the right half of the upper grid.
+void FillLavaMeetsWaterScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed);
+
+// Scatters a few sand grains over an otherwise empty grid.
+void FillSparseScene(Grid& cells, int gridWidth, int gridHeight, unsigned int seed);
+
+// Returns every scene, in a fixed order.
+const std::vector<Scene>& GetScenes();
+
+// Returns the scene with the name, or nullptr if there is none.
+const Scene* FindScene(const std::string& name);
@@ -0,0 +1,403 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "simd.h"
+#include "materials.h"
+
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+// Each kernel is compiled for its instruction set alone, the rest of the engine keeps the
+// baseline one. Visual Studio accepts any intrinsic without a flag.
+#ifdef __GNUC__
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+constexpr int SIMD_PATH_COUNT = static_cast<int>(SimdPath::Count);
+
+// --------------------------------------------------------------------------------------------
+
+static void ConvertMaterialsToPixelsScalar(const uint8_t* materials, uint32_t* pixels, int count, const uint32_t* palette)
+{
+    for (int i = 0; i < count; i++)
+    {
+        pixels[i] = palette[materials[i]];
+    }
+}
+
+static bool BytesAtMostScalar(const uint8_t* bytes, int count, uint8_t max)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (bytes[i] > max)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t PackLowestBitsScalar(const uint8_t* bytes, int count)
+{
+    uint64_t bits = 0;
+    int i = 0;
+
+    // The multiply gathers the lowest bit of each of the 8 bytes into the top byte
+    for (; i + 8 <= count; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        bits |= (((word & 0x0101010101010101ULL) * 0x0102040810204080ULL) >> 56) << i;
+    }
+
+    for (; i < count; i++)
+    {
+        bits |= static_cast<uint64_t>(bytes[i] & 1) << i;
+    }
+
+    return bits;
+}
+
+#if SIMD_X86
+
+// SSE2 has no lane shuffle to look the palette up with, the scalar loop is as fast.
+
+static bool BytesAtMostSSE2(const uint8_t* bytes, int count, uint8_t max)
+{
+    const __m128i maxBytes = _mm_set1_epi8(static_cast<char>(max));
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(values, maxBytes), maxBytes)) != 0xFFFF)
+        {
+            return false;
+        }
+    }
+
+    return BytesAtMostScalar(bytes + i, count - i, max);
+}
+
+static uint64_t PackLowestBitsSSE2(const uint8_t* bytes, int count)
+{
+    uint64_t bits = 0;
+    int i = 0;
+
+    // Moved to the sign bit of each byte, where movemask reads it
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        bits |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_slli_epi16(values, 7)))) << i;
+    }
+
+    return bits | (i < count ? PackLowestBitsScalar(bytes + i, count - i) << i : 0);
+}
+
+SIMD_TARGET("avx2")
+static void ConvertMaterialsToPixelsAVX2(const uint8_t* materials, uint32_t* pixels, int count, const uint32_t* palette)
+{
+    int i = 0;
+
+    if (MATERIAL_COUNT <= 8)
+    {
+        uint32_t lanes[8] = {};
+        std::memcpy(lanes, palette, std::min(MATERIAL_COUNT, 8) * sizeof(uint32_t));
+        const __m256i table = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes));
+
+        // The material of each lane picks its pixel from the table
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(materials + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), _mm256_permutevar8x32_epi32(table, indices));
+        }
+    }
+    else
+    {
+        // The palette does not fit in the lanes, each lane loads its pixel from memory
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(materials + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), indices, 4));
+        }
+    }
+
+    ConvertMaterialsToPixelsScalar(materials + i, pixels + i, count - i, palette);
+}
+
+SIMD_TARGET("avx2")
+static bool BytesAtMostAVX2(const uint8_t* bytes, int count, uint8_t max)
+{
+    const __m256i maxBytes = _mm256_set1_epi8(static_cast<char>(max));
+    int i = 0;
+
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+        if (static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(values, maxBytes), maxBytes))) != 0xFFFFFFFFu)
+        {
+            return false;
+        }
+    }
+
+    return BytesAtMostSSE2(bytes + i, count - i, max);
+}
+
+SIMD_TARGET("avx2")
+static uint64_t PackLowestBitsAVX2(const uint8_t* bytes, int count)
+{
+    uint64_t bits = 0;
+    int i = 0;
+
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+        bits |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(values, 7)))) << i;
+    }
+
+    return bits | (i < count ? PackLowestBitsSSE2(bytes + i, count - i) << i : 0);
+}
+
+// Returns the mask of the first count lanes, count in [0, 64].
+static __mmask64 GetLaneMask(int count)
+{
+    return count >= 64 ? ~0ULL : (1ULL << count) - 1;
+}
+
+SIMD_TARGET("avx512f,avx512bw,avx512vl")
+static void ConvertMaterialsToPixelsAVX512(const uint8_t* materials, uint32_t* pixels, int count, const uint32_t* palette)
+{
+    uint32_t lanes[16] = {};
+    std::memcpy(lanes, palette, std::min(MATERIAL_COUNT, 16) * sizeof(uint32_t));
+    const __m512i table = _mm512_loadu_si512(lanes);
+
+    // The last pixels are written through a lane mask instead of a scalar loop. Only zero
+    // masking forms are used, the others start from an undefined register GCC warns about.
+    for (int i = 0; i < count; i += 16)
+    {
+        const __mmask16 lanesLeft = static_cast<__mmask16>(GetLaneMask(std::min(count - i, 16)));
+        const __m512i indices = _mm512_maskz_cvtepu8_epi32(lanesLeft, _mm_maskz_loadu_epi8(lanesLeft, materials + i));
+
+        // Past 16 materials the palette does not fit in the lanes, each lane loads its pixel from memory
+        const __m512i lanePixels = MATERIAL_COUNT <= 16 ? _mm512_maskz_permutexvar_epi32(lanesLeft, indices, table)
+                                                        : _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), lanesLeft, indices, palette, 4);
+        _mm512_mask_storeu_epi32(pixels + i, lanesLeft, lanePixels);
+    }
+}
+
+SIMD_TARGET("avx512f,avx512bw,avx512vl")
+static bool BytesAtMostAVX512(const uint8_t* bytes, int count, uint8_t max)
+{
+    const __m512i maxBytes = _mm512_set1_epi8(static_cast<char>(max));
+
+    // Masked out bytes load as zero, never above the max
+    for (int i = 0; i < count; i += 64)
+    {
+        const __m512i values = _mm512_maskz_loadu_epi8(GetLaneMask(count - i), bytes + i);
+        if (_mm512_cmpgt_epu8_mask(values, maxBytes))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+SIMD_TARGET("avx512f,avx512bw,avx512vl")
+static uint64_t PackLowestBitsAVX512(const uint8_t* bytes, int count)
+{
+    const __m512i values = _mm512_maskz_loadu_epi8(GetLaneMask(count), bytes);
+    return _mm512_test_epi8_mask(values, _mm512_set1_epi8(1));
+}
+
+#endif
+
+// --------------------------------------------------------------------------------------------
+
+struct SimdKernels
+{
+    void (*convertMaterialsToPixels)(const uint8_t*, uint32_t*, int, const uint32_t*);
+    bool (*bytesAtMost)(const uint8_t*, int, uint8_t);
+    uint64_t (*packLowestBits)(const uint8_t*, int);
+};
+
+// Kernels of each path, indexed by SimdPath.
+static const SimdKernels simdKernels[SIMD_PATH_COUNT] = {
+    { ConvertMaterialsToPixelsScalar, BytesAtMostScalar, PackLowestBitsScalar },
+#if SIMD_X86
+    { ConvertMaterialsToPixelsScalar, BytesAtMostSSE2, PackLowestBitsSSE2 },
+    { ConvertMaterialsToPixelsAVX2, BytesAtMostAVX2, PackLowestBitsAVX2 },
+    { ConvertMaterialsToPixelsAVX512, BytesAtMostAVX512, PackLowestBitsAVX512 },
+#else
+    { ConvertMaterialsToPixelsScalar, BytesAtMostScalar, PackLowestBitsScalar },
+    { ConvertMaterialsToPixelsScalar, BytesAtMostScalar, PackLowestBitsScalar },
+    { ConvertMaterialsToPixelsScalar, BytesAtMostScalar, PackLowestBitsScalar },
+#endif
+};
+
+static std::atomic<int> selectedPath{ -1 }; // Picked on first use, unless set before
+
+// Returns the kernels of the selected path.
+static const SimdKernels& GetKernels()
+{
+    int path = selectedPath.load(std::memory_order_relaxed);
+    if (path < 0)
+    {
+        // Threads racing here all store the same path
+        path = static_cast<int>(GetSupportedSimdPath());
+        selectedPath.store(path, std::memory_order_relaxed);
+    }
+    return simdKernels[path];
+}
+
+#if SIMD_X86
+
+// Fills the registers with the CPUID leaf, eax, ebx, ecx then edx.
+static void ReadCpuid(uint32_t leaf, uint32_t subleaf, uint32_t (&registers)[4])
+{
+#ifdef _MSC_VER
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+    std::memcpy(registers, values, sizeof(registers));
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// Returns the register states the OS saves on a context switch, XCR0.
+static uint64_t ReadEnabledStates()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t low;
+    uint32_t high;
+    __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+}
+
+#endif
+
+SimdPath GetSupportedSimdPath()
+{
+#if SIMD_X86
+    uint32_t registers[4];
+    ReadCpuid(0, 0, registers);
+    const uint32_t maxLeaf = registers[0];
+
+    ReadCpuid(1, 0, registers);
+    const bool hasSSE2 = (registers[3] >> 26) & 1;
+    const bool hasOSXSave = (registers[2] >> 27) & 1;
+    const bool hasAVX = (registers[2] >> 28) & 1;
+    if (!hasSSE2)
+    {
+        return SimdPath::Scalar;
+    }
+
+    // The wide registers are only usable when the OS saves them, YMM state for AVX2, along
+    // with the opmask and ZMM states for AVX-512
+    const uint64_t enabledStates = hasOSXSave ? ReadEnabledStates() : 0;
+    const bool savesYmm = (enabledStates & 0x6) == 0x6;
+    const bool savesZmm = (enabledStates & 0xE6) == 0xE6;
+
+    bool hasAVX2 = false;
+    bool hasAVX512 = false;
+    if (maxLeaf >= 7)
+    {
+        ReadCpuid(7, 0, registers);
+        hasAVX2 = (registers[1] >> 5) & 1;
+        hasAVX512 = ((registers[1] >> 16) & 1) && ((registers[1] >> 30) & 1) && ((registers[1] >> 31) & 1); // F, BW and VL
+    }
+
+    if (hasAVX && hasAVX2 && hasAVX512 && savesZmm)
+    {
+        return SimdPath::AVX512;
+    }
+    if (hasAVX && hasAVX2 && savesYmm)
+    {
+        return SimdPath::AVX2;
+    }
+    return SimdPath::SSE2;
+#else
+    return SimdPath::Scalar;
+#endif
+}
+
+SimdPath GetSimdPath()
+{
+    GetKernels();
+    return static_cast<SimdPath>(selectedPath.load(std::memory_order_relaxed));
+}
+
+SimdPath SetSimdPath(SimdPath path)
+{
+    const SimdPath picked = std::min(path, GetSupportedSimdPath());
+    selectedPath.store(static_cast<int>(picked), std::memory_order_relaxed);
+    return picked;
+}
+
+const char* GetSimdPathName(SimdPath path)
+{
+    switch (path)
+    {
+    case SimdPath::SSE2:
+        return "sse2";
+
+    case SimdPath::AVX2:
+        return "avx2";
+
+    case SimdPath::AVX512:
+        return "avx512";
+
+    default:
+        return "scalar";
+    }
+}
+
+bool ParseSimdPath(const std::string& name, SimdPath& path)
+{
+    for (SimdPath option : { SimdPath::Scalar, SimdPath::SSE2, SimdPath::AVX2, SimdPath::AVX512 })
+    {
+        if (name == GetSimdPathName(option))
+        {
+            path = option;
+            return true;
+        }
+    }
+    return false;
+}
+
+// --------------------------------------------------------------------------------------------
+
+void ConvertMaterialsToPixels(const uint8_t* materials, uint32_t* pixels, int count, const uint32_t* palette)
+{
+    GetKernels().convertMaterialsToPixels(materials, pixels, count, palette);
+}
+
+bool BytesAtMost(const uint8_t* bytes, int count, uint8_t max)
+{
+    return GetKernels().bytesAtMost(bytes, count, max);
+}
+
+uint64_t PackLowestBits(const uint8_t* bytes, int count)
+{
+    return GetKernels().packLowestBits(bytes, count);
+}
@@ -0,0 +1,50 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Vectorized kernels, built for several instruction sets in the same binary. The fastest
+// one the CPU supports is picked with CPUID on first use, so the binaries run on any x86-64
+// CPU without being built for the machine they run on.
+
+// Instruction sets the kernels are built for, from the slowest to the fastest.
+enum class SimdPath
+{
+    Scalar, // Plain C++, also the only path off x86
+    SSE2,
+    AVX2,
+    AVX512, // AVX-512 F, BW and VL
+    Count
+};
+
+// Returns the fastest path the CPU and the OS support.
+SimdPath GetSupportedSimdPath();
+
+// Returns the path the kernels run with.
+SimdPath GetSimdPath();
+
+// Makes the kernels run with the path, or with the supported one if the CPU lacks it. Must be
+// called before any other thread runs a kernel. Returns the path picked.
+SimdPath SetSimdPath(SimdPath path);
+
+// Returns the name of the path, as accepted by ParseSimdPath.
+const char* GetSimdPathName(SimdPath path);
+
+// Returns false if the name is not one of scalar, sse2, avx2 or avx512.
+bool ParseSimdPath(const std::string& name, SimdPath& path);
+
+// Writes the pixel of each of the count materials, looked up in the palette, which holds
+// a pixel for each of the MATERIAL_COUNT materials.
+void ConvertMaterialsToPixels(const uint8_t* materials, uint32_t* pixels, int count, const uint32_t* palette);
+
+// Returns true if none of the count bytes is above the max.
+bool BytesAtMost(const uint8_t* bytes, int count, uint8_t max);
+
+// Returns the lowest bit of each of the count bytes, at most 64, packed in order.
+uint64_t PackLowestBits(const uint8_t* bytes, int count);
@@ -0,0 +1,567 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "simulation.h"
+#include "random.h"
+#include "sand_kernel.h"
+#include "trace.h"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+constexpr float PI = 3.14159265358979323846f;
+
+// Every ordering of the four directions a gas particle can try, one is picked at random.
+static const uint8_t GAS_DIRECTION_ORDERS[24][4] = {
+    { 0, 1, 2, 3 }, { 0, 1, 3, 2 }, { 0, 2, 1, 3 }, { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 0, 3, 2, 1 },
+    { 1, 0, 2, 3 }, { 1, 0, 3, 2 }, { 1, 2, 0, 3 }, { 1, 2, 3, 0 }, { 1, 3, 0, 2 }, { 1, 3, 2, 0 },
+    { 2, 0, 1, 3 }, { 2, 0, 3, 1 }, { 2, 1, 0, 3 }, { 2, 1, 3, 0 }, { 2, 3, 0, 1 }, { 2, 3, 1, 0 },
+    { 3, 0, 1, 2 }, { 3, 0, 2, 1 }, { 3, 1, 0, 2 }, { 3, 1, 2, 0 }, { 3, 2, 0, 1 }, { 3, 2, 1, 0 }
+};
+
+// --------------------------------------------------------------------------------------------
+
+void RevealParticleAt(Grid& cells, int gridWidth, int x, int y, MaterialType materialType)
+{
+    int spawnIndex = GetCellIndexAt(cells, gridWidth, x, y);
+    if (spawnIndex >= 0)
+    {
+        SetCellMaterial(cells, spawnIndex, materialType);
+        WakeCells(cells, x - 1, y - 1, x + 1, y + 1);
+    }
+}
+
+void RevealParticlesAt(Grid& cells, int gridWidth, const CellBounds& bounds, MaterialType materialType)
+{
+    int xStart = bounds.xStart;
+    int yStart = bounds.yStart;
+    int xEnd = bounds.xEnd;
+    int yEnd = bounds.yEnd;
+
+    int totalParticles = (xEnd - xStart + 1) * (yEnd - yStart + 1);
+
+    // Percentage of particles to reveal in each iteration
+    double revealPercentage = 0.2;
+    int particlesToReveal = static_cast<int>(totalParticles * revealPercentage);
+
+    int centerX = static_cast<int>(std::floor((xStart + xEnd) / 2));
+    int centerY = static_cast<int>(std::floor((yStart + yEnd) / 2));
+
+    // Several strokes may land on the same frame, each must scatter differently
+    const uint32_t stroke = cells.revealCount++;
+
+    for (int i = 0; i < particlesToReveal; ++i)
+    {
+        float angle = RandomFloat(HashRandom(cells.seed, cells.frame, stroke, 2 * i), 0.0f, 2.0f * PI);
+        float radius = RandomFloat(HashRandom(cells.seed, cells.frame, stroke, 2 * i + 1), 0.0f, static_cast<float>(std::min(centerX - xStart, centerY - yStart)));
+        int x = static_cast<int>(centerX + radius * std::cos(angle));
+        int y = static_cast<int>(centerY + radius * std::sin(angle));
+
+        // Ensure the generated coordinates are within the bounds
+        x = std::max(xStart, std::min(x, xEnd));
+        y = std::max(yStart, std::min(y, yEnd));
+
+        RevealParticleAt(cells, gridWidth, x, y, materialType);
+    }
+}
+
+// --------------------------------------------------------------------------------------------
+
+// Moves the particle at index into the target cell it is allowed to replace. The target
+// goes where the particle was, turned into what the interaction table says.
+static void ReplaceCell(Grid& cells, int index, int targetIndex)
+{
+    const MaterialInteraction& interaction = GetMaterialInteraction(GetCellMaterial(cells, index), GetCellMaterial(cells, targetIndex));
+
+    SwapCells(cells, targetIndex, index);
+    WriteCellMaterial(cells, index, static_cast<MaterialType>(interaction.becomes));
+}
+
+// Returns the index of the cell dx and dy away from the cell at x and y, index. The border
+// makes the cell valid even on the edges of the grid, unless the grid wraps around.
+template <BoundaryMode Mode>
+static int GetNeighborIndex(const Grid& cells, int index, int x, int y, int dx, int dy)
+{
+    if (Mode == BoundaryMode::Wrap)
+    {
+        int neighborX = x + dx;
+        int neighborY = y + dy;
+        neighborX = neighborX < 0 ? neighborX + cells.width : (neighborX >= cells.width ? neighborX - cells.width : neighborX);
+        neighborY = neighborY < 0 ? neighborY + cells.height : (neighborY >= cells.height ? neighborY - cells.height : neighborY);
+        return GetCellIndex(cells.width, neighborX, neighborY);
+    }
+
+    return index + dy * cells.stride + dx;
+}
+
+// Returns true if a particle may move into the cell at index without any interaction.
+template <BoundaryMode Mode>
+static bool CellIsFree(const Grid& cells, int index)
+{
+    return CellIsEmpty(cells, index) || (Mode == BoundaryMode::Open && GetCellMaterial(cells, index) == MaterialType::Void);
+}
+
+// Moves the particle at index into the free cell at targetIndex.
+template <BoundaryMode Mode>
+static void MoveCell(Grid& cells, int index, int targetIndex)
+{
+    if (Mode == BoundaryMode::Open)
+    {
+        // The void left behind turns into an empty cell
+        ReplaceCell(cells, index, targetIndex);
+    }
+    else
+    {
+        SwapCells(cells, targetIndex, index);
+    }
+}
+
+// Moves of the sand and liquid kernels after the one straight down, in the order they are
+// tried. The signature of a particle has the bit of every move its neighborhood allows set
+// and the lowest one is taken, so a single bit scan replaces a chain of branches that
+// mispredict on uneven terrain.
+enum ParticleMove
+{
+    MOVE_BELOW_LEFT,
+    MOVE_BELOW_RIGHT,
+    MOVE_LEFT,
+    MOVE_RIGHT,
+    MOVE_NONE, // Always set, the particle stays when no other move is allowed
+    MOVE_COUNT
+};
+
+// Moves the particle at index to the target of the first move of the signature. Returns
+// the index of the cell it ends up in.
+template <BoundaryMode Mode>
+static int MakeFirstMove(Grid& cells, int index, const int (&targets)[MOVE_COUNT], uint32_t signature)
+{
+    const int move = CountTrailingZeros(signature | (1u << MOVE_NONE));
+    const int targetIndex = targets[move];
+
+    if (move != MOVE_NONE)
+    {
+        MoveCell<Mode>(cells, index, targetIndex);
+    }
+
+    return targetIndex;
+}
+
+template <BoundaryMode Mode>
+int UpdateSolid(Grid& cells, int gridWidth, int x, int y)
+{
+    int solidIndex = GetCellIndex(gridWidth, x, y);
+    MaterialType solidMaterial = GetCellMaterial(cells, solidIndex);
+
+    // Get neighboring cells
+    int bIndex = GetNeighborIndex<Mode>(cells, solidIndex, x, y, 0, 1); // Below
+    int blIndex = GetNeighborIndex<Mode>(cells, solidIndex, x, y, -1, 1); // Below left
+    int brIndex = GetNeighborIndex<Mode>(cells, solidIndex, x, y, 1, 1); // Below right
+
+    // Falling is the common case and predicts well, it stays a branch
+    if (ParticleCanReplace(solidMaterial, GetCellMaterial(cells, bIndex))) // Move down
+    {
+        ReplaceCell(cells, solidIndex, bIndex);
+        return bIndex;
+    }
+
+    const int targets[MOVE_COUNT] = { blIndex, brIndex, solidIndex, solidIndex, solidIndex };
+    const uint32_t signature = static_cast<uint32_t>(CellIsFree<Mode>(cells, blIndex)) << MOVE_BELOW_LEFT
+                             | static_cast<uint32_t>(CellIsFree<Mode>(cells, brIndex)) << MOVE_BELOW_RIGHT;
+
+    return MakeFirstMove<Mode>(cells, solidIndex, targets, signature);
+}
+
+template <BoundaryMode Mode>
+int UpdateLiquid(Grid& cells, int gridWidth, int x, int y)
+{
+    int liquidIndex = GetCellIndex(gridWidth, x, y);
+    MaterialType liquidMaterial = GetCellMaterial(cells, liquidIndex);
+
+    // Get neighboring cells
+    int lIndex = GetNeighborIndex<Mode>(cells, liquidIndex, x, y, -1, 0); // Left
+    int rIndex = GetNeighborIndex<Mode>(cells, liquidIndex, x, y, 1, 0); // Right
+
+    int bIndex = GetNeighborIndex<Mode>(cells, liquidIndex, x, y, 0, 1); // Below
+    int blIndex = GetNeighborIndex<Mode>(cells, liquidIndex, x, y, -1, 1); // Below left
+    int brIndex = GetNeighborIndex<Mode>(cells, liquidIndex, x, y, 1, 1); // Below right
+
+    if (ParticleCanReplace(liquidMaterial, GetCellMaterial(cells, bIndex))) // Move down
+    {
+        ReplaceCell(cells, liquidIndex, bIndex);
+        return bIndex;
+    }
+
+    const int targets[MOVE_COUNT] = { blIndex, brIndex, lIndex, rIndex, liquidIndex };
+    const uint32_t signature = static_cast<uint32_t>(CellIsFree<Mode>(cells, blIndex)) << MOVE_BELOW_LEFT
+                             | static_cast<uint32_t>(CellIsFree<Mode>(cells, brIndex)) << MOVE_BELOW_RIGHT
+                             | static_cast<uint32_t>(CellIsFree<Mode>(cells, lIndex)) << MOVE_LEFT
+                             | static_cast<uint32_t>(CellIsFree<Mode>(cells, rIndex)) << MOVE_RIGHT;
+
+    return MakeFirstMove<Mode>(cells, liquidIndex, targets, signature);
+}
+
+template <BoundaryMode Mode>
+int UpdateGas(Grid& cells, int gridWidth, int x, int y)
+{
+    int gasIndex = GetCellIndex(gridWidth, x, y);
+    MaterialType gasMaterial = GetCellMaterial(cells, gasIndex);
+
+    // Get neighboring cells
+    int aIndex = GetNeighborIndex<Mode>(cells, gasIndex, x, y, 0, -1); // Above
+    int lIndex = GetNeighborIndex<Mode>(cells, gasIndex, x, y, -1, 0); // Left
+    int rIndex = GetNeighborIndex<Mode>(cells, gasIndex, x, y, 1, 0); // Right
+    int bIndex = GetNeighborIndex<Mode>(cells, gasIndex, x, y, 0, 1); // Below
+
+    // Randomly select a direction to move
+    const int directions[4] = { aIndex, lIndex, rIndex, bIndex };
+    const uint8_t* order = GAS_DIRECTION_ORDERS[RandomBelow(HashRandom(cells.seed, cells.frame, x, y), 24)];
+
+    for (int i = 0; i < 4; i++)
+    {
+        const int direction = directions[order[i]];
+        if (ParticleCanReplace(gasMaterial, GetCellMaterial(cells, direction)))
+        {
+            ReplaceCell(cells, gasIndex, direction);
+            return direction;
+        }
+    }
+
+    return gasIndex;
+}
+
+// Each boundary mode gets its own copy of the kernels, so the mode costs nothing per cell.
+template int UpdateSolid<BoundaryMode::Solid>(Grid&, int, int, int);
+template int UpdateSolid<BoundaryMode::Wrap>(Grid&, int, int, int);
+template int UpdateSolid<BoundaryMode::Open>(Grid&, int, int, int);
+template int UpdateLiquid<BoundaryMode::Solid>(Grid&, int, int, int);
+template int UpdateLiquid<BoundaryMode::Wrap>(Grid&, int, int, int);
+template int UpdateLiquid<BoundaryMode::Open>(Grid&, int, int, int);
+template int UpdateGas<BoundaryMode::Solid>(Grid&, int, int, int);
+template int UpdateGas<BoundaryMode::Wrap>(Grid&, int, int, int);
+template int UpdateGas<BoundaryMode::Open>(Grid&, int, int, int);
+
+// Updates the particle of the material at x and y, index, with the kernel of its material.
+// If it moved, the cell it ends up in is flagged as updated in the chunk. Returns the index
+// of that cell.
+template <BoundaryMode Mode>
+static int UpdateParticle(Grid& cells, Chunk& chunk, int gridWidth, MaterialType materialType, int index, int x, int y)
+{
+    int newIndex;
+
+    switch (materialType)
+    {
+    case MaterialType::Sand:
+        newIndex = UpdateSolid<Mode>(cells, gridWidth, x, y);
+        break;
+
+    case MaterialType::Lava:
+    case MaterialType::Water:
+        newIndex = UpdateLiquid<Mode>(cells, gridWidth, x, y);
+        break;
+
+    case MaterialType::Acid:
+    case MaterialType::ToxicGas:
+        newIndex = UpdateGas<Mode>(cells, gridWidth, x, y);
+        break;
+
+    default:
+        newIndex = index;
+        break;
+    }
+
+    // A particle staying in place is never visited again this frame. One moving leaves behind
+    // an empty cell or the particle it replaced, which is behind the visit too.
+    if (newIndex != index)
+    {
+        cells.flags[index] &= ~CELL_FLAG_UPDATED;
+        MarkCellUpdated(cells, chunk, newIndex);
+    }
+    return newIndex;
+}
+
+// Updates the particles in the rect with the kernels of the boundary mode.
+template <BoundaryMode Mode>
+static int UpdateParticlesInRectWith(Grid& cells, int gridWidth, const DirtyRect& rect)
+{
+    Chunk& chunk = GetChunkAt(cells, rect.minX, rect.minY);
+    int updatedCount = 0;
+
+    for (int y = rect.maxY; y >= rect.minY; y--)
+    {
+        const int rowIndex = GetCellIndex(gridWidth, 0, y);
+        const int end = rowIndex + rect.maxX + 1;
+
+        for (int index = FindNextNonEmpty(cells, rowIndex + rect.minX, end); index < end; index = FindNextNonEmpty(cells, index + 1, end))
+        {
+            // Already updated this frame, after moving into a row or column visited later
+            if (cells.flags[index] & CELL_FLAG_UPDATED)
+            {
+                continue;
+            }
+
+            updatedCount++;
+            UpdateParticle<Mode>(cells, chunk, gridWidth, GetCellMaterial(cells, index), index, index - rowIndex, y);
+        }
+    }
+
+    return updatedCount;
+}
+
+int UpdateParticlesInRect(Grid& cells, int gridWidth, const DirtyRect& rect)
+{
+    switch (cells.boundaryMode)
+    {
+    case BoundaryMode::Wrap:
+        return UpdateParticlesInRectWith<BoundaryMode::Wrap>(cells, gridWidth, rect);
+
+    case BoundaryMode::Open:
+        return UpdateParticlesInRectWith<BoundaryMode::Open>(cells, gridWidth, rect);
+
+    default:
+        return UpdateParticlesInRectWith<BoundaryMode::Solid>(cells, gridWidth, rect);
+    }
+}
+
+// Lists the cells of the chunk around the cell at x and y as active for this frame.
+static void ListNeighborCells(uint64_t* activeRows, int minX, int minY, int maxX, int maxY, int x, int y)
+{
+    const int firstX = std::max(x - 1, minX);
+    const int lastX = std::min(x + 1, maxX);
+    if (firstX > lastX)
+    {
+        return;
+    }
+
+    const uint64_t rowMask = GetBitRange(firstX - minX, lastX - minX);
+    for (int neighborY = std::max(y - 1, minY); neighborY <= std::min(y + 1, maxY); neighborY++)
+    {
+        activeRows[neighborY - minY] |= rowMask;
+    }
+}
+
+// Updates the active cells of the chunk with the kernels of the boundary mode, bottom row
+// first and each row from left to right, as in the rects. When a particle moves, the cells
+// of the chunk around it are listed too, and the ones not visited yet are updated this
+// frame, so a column of sand falls as a whole instead of one grain per frame.
+template <BoundaryMode Mode>
+static int UpdateActiveCellsWith(Grid& cells, int gridWidth, int chunkIndex)
+{
+    Chunk& chunk = cells.chunks[chunkIndex];
+    uint64_t* activeRows = chunk.currentCells;
+    const int minX = (chunkIndex % cells.chunksX) * CHUNK_SIZE;
+    const int minY = (chunkIndex / cells.chunksX) * CHUNK_SIZE;
+    const int maxX = std::min(minX + CHUNK_SIZE, gridWidth) - 1;
+    const int maxY = std::min(minY + CHUNK_SIZE, cells.height) - 1;
+    int updatedCount = 0;
+
+    // The rows below the rect hold no cell, the rows above may be listed by the moves
+    for (int y = chunk.current.maxY; y >= minY; y--)
+    {
+        const uint64_t& activeRow = activeRows[y - minY];
+        const int rowIndex = GetCellIndex(gridWidth, minX, y);
+
+        // Only the listed cells holding a particle are visited. The row and its occupancy are
+        // read again after each move, a moving particle may list or fill the next cells.
+        for (uint64_t remaining = activeRow & LoadOccupancy(cells, rowIndex); remaining != 0;)
+        {
+            const int bit = CountTrailingZeros(remaining);
+            const int index = rowIndex + bit;
+            remaining &= remaining - 1;
+
+            // The particle may have moved in after being updated this frame
+            if (cells.flags[index] & CELL_FLAG_UPDATED)
+            {
+                continue;
+            }
+
+            updatedCount++;
+
+            const int newIndex = UpdateParticle<Mode>(cells, chunk, gridWidth, GetCellMaterial(cells, index), index, minX + bit, y);
+            if (newIndex != index)
+            {
+                ListNeighborCells(activeRows, minX, minY, maxX, maxY, minX + bit, y);
+                ListNeighborCells(activeRows, minX, minY, maxX, maxY, GetCellX(cells, newIndex), GetCellY(cells, newIndex));
+                remaining = bit < 63 ? activeRow & LoadOccupancy(cells, rowIndex) & (~0ULL << (bit + 1)) : 0;
+            }
+        }
+    }
+
+    // Cleared while in cache, the cells of the next frame are then only copied to the rows
+    // of its rect
+    std::fill_n(activeRows, CHUNK_SIZE, 0);
+
+    return updatedCount;
+}
+
+int UpdateActiveCells(Grid& cells, int gridWidth, int chunkIndex)
+{
+    switch (cells.boundaryMode)
+    {
+    case BoundaryMode::Wrap:
+        return UpdateActiveCellsWith<BoundaryMode::Wrap>(cells, gridWidth, chunkIndex);
+
+    case BoundaryMode::Open:
+        return UpdateActiveCellsWith<BoundaryMode::Open>(cells, gridWidth, chunkIndex);
+
+    default:
+        return UpdateActiveCellsWith<BoundaryMode::Solid>(cells, gridWidth, chunkIndex);
+    }
+}
+
+// Updates the awake chunk as the step mode says. Returns the number of particles updated.
+static int UpdateChunk(Grid& cells, int gridWidth, int chunkIndex)
+{
+    TraceZone zone("Chunk", chunkIndex);
+
+    const DirtyRect& rect = cells.chunks[chunkIndex].current;
+
+    if (cells.stepMode == StepMode::ActiveCells)
+    {
+        return UpdateActiveCells(cells, gridWidth, chunkIndex);
+    }
+    if (cells.stepMode == StepMode::SandBits && RectHoldsOnlySand(cells, gridWidth, rect))
+    {
+        return UpdateSandInRect(cells, gridWidth, rect);
+    }
+    return UpdateParticlesInRect(cells, gridWidth, rect);
+}
+
+// Updates the awake chunks in four checkerboard passes. Within a pass, the updated chunks
+// are at least one chunk apart, and a particle never reads or moves further than one cell
+// away, so no two threads ever touch the same cells. On a wrapping grid, the chunks along
+// the edges also touch the chunks on the opposite edge, they are updated after the others.
+static int UpdateChunksInParallel(Grid& cells, int gridWidth, ThreadPool& pool)
+{
+    std::vector<int> passChunks;
+    std::vector<int> edgeChunks;
+    std::vector<int> passUpdatedCounts;
+    passChunks.reserve(cells.chunks.size() / 4 + 1);
+
+    const bool wraps = cells.boundaryMode == BoundaryMode::Wrap;
+
+    int updatedCount = 0;
+
+    for (int pass = 0; pass < 4; pass++)
+    {
+        // Lower row of chunks first, as in the sequential update
+        const int passX = pass % 2;
+        const int passY = 1 - pass / 2;
+
+        passChunks.clear();
+        edgeChunks.clear();
+        for (int chunkY = passY; chunkY < cells.chunksY; chunkY += 2)
+        {
+            for (int chunkX = passX; chunkX < cells.chunksX; chunkX += 2)
+            {
+                const int chunkIndex = chunkY * cells.chunksX + chunkX;
+                if (!cells.chunks[chunkIndex].IsAwake())
+                {
+                    continue;
+                }
+
+                const bool onEdge = chunkX == 0 || chunkY == 0 || chunkX == cells.chunksX - 1 || chunkY == cells.chunksY - 1;
+                if (wraps && onEdge)
+                {
+                    edgeChunks.push_back(chunkIndex);
+                }
+                else
+                {
+                    passChunks.push_back(chunkIndex);
+                }
+            }
+        }
+
+        passUpdatedCounts.assign(passChunks.size(), 0);
+        pool.ParallelFor(static_cast<int>(passChunks.size()), [&](int i)
+        {
+            passUpdatedCounts[i] = UpdateChunk(cells, gridWidth, passChunks[i]);
+        });
+
+        for (int count : passUpdatedCounts)
+        {
+            updatedCount += count;
+        }
+
+        for (int chunkIndex : edgeChunks)
+        {
+            updatedCount += UpdateChunk(cells, gridWidth, chunkIndex);
+        }
+    }
+
+    return updatedCount;
+}
+
+// Updates the awake chunks one after the other, from the bottom row of chunks to the top one.
+static int UpdateChunksInOrder(Grid& cells, int gridWidth)
+{
+    int updatedCount = 0;
+
+    for (int chunkY = cells.chunksY - 1; chunkY >= 0; chunkY--)
+    {
+        for (int chunkX = 0; chunkX < cells.chunksX; chunkX++)
+        {
+            const int chunkIndex = chunkY * cells.chunksX + chunkX;
+            if (cells.chunks[chunkIndex].IsAwake())
+            {
+                updatedCount += UpdateChunk(cells, gridWidth, chunkIndex);
+            }
+        }
+    }
+
+    return updatedCount;
+}
+
+int UpdateParticleSimulation(Grid& cells, ThreadPool* pool)
+{
+    TraceZone zone("Step");
+    const int gridWidth = cells.width;
+    cells.frame++;
+
+    // Moves made during this frame must only wake chunks for the next one. The particles
+    // that moved last frame may be updated again.
+    for (Chunk& chunk : cells.chunks)
+    {
+        // The cells listed for the next frame lie in its rect, and the chunk updated last
+        // cleared its own, so a chunk left asleep costs nothing
+        if (cells.stepMode == StepMode::ActiveCells)
+        {
+            for (int y = chunk.next.minY; y <= chunk.next.maxY; y++)
+            {
+                chunk.currentCells[y % CHUNK_SIZE] = chunk.nextCells[y % CHUNK_SIZE];
+                chunk.nextCells[y % CHUNK_SIZE] = 0;
+            }
+        }
+
+        chunk.current = chunk.next;
+        chunk.next = DirtyRect();
+
+        for (int index : chunk.updatedCells)
+        {
+            cells.flags[index] &= ~CELL_FLAG_UPDATED;
+        }
+        chunk.updatedCells.clear();
+    }
+
+    int updatedCount = 0;
+
+    if (pool && pool->GetThreadCount() > 1)
+    {
+        updatedCount = UpdateChunksInParallel(cells, gridWidth, *pool);
+    }
+    else
+    {
+        updatedCount = UpdateChunksInOrder(cells, gridWidth);
+    }
+
+    // Particles that moved into the border left the grid
+    if (cells.boundaryMode == BoundaryMode::Open)
+    {
+        cells.FillBorder();
+    }
+
+    return updatedCount;
+}
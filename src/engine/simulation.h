@@ -0,0 +1,57 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include "grid.h"
+#include "materials.h"
+#include "thread_pool.h"
+
+// Rect of cells in grid coordinates, bounds included.
+struct CellBounds
+{
+    int xStart;
+    int yStart;
+    int xEnd;
+    int yEnd;
+};
+
+// Lights up a particle of the material type from the grid located at x and y.
+void RevealParticleAt(Grid& cells, int gridWidth, int x, int y, MaterialType materialType);
+
+// Lights up particles of the material type from the grid located in the bounds.
+void RevealParticlesAt(Grid& cells, int gridWidth, const CellBounds& bounds, MaterialType materialType);
+
+// Updates the solid particle located at x and y on the grid, with the edges behaving as the
+// boundary mode says. Returns the index of the cell the particle ends up in.
+template <BoundaryMode Mode>
+int UpdateSolid(Grid& cells, int gridWidth, int x, int y);
+
+// Updates the liquid particle located at x and y on the grid, with the edges behaving as the
+// boundary mode says. Returns the index of the cell the particle ends up in.
+template <BoundaryMode Mode>
+int UpdateLiquid(Grid& cells, int gridWidth, int x, int y);
+
+// Updates the gas particle located at x and y on the grid, with the edges behaving as the
+// boundary mode says. Returns the index of the cell the particle ends up in.
+template <BoundaryMode Mode>
+int UpdateGas(Grid& cells, int gridWidth, int x, int y);
+
+// Updates the particles located in the rect, bounds included, from the bottom row to the top one.
+// The rect lies in a single chunk, which lists the particles it moves. Particles already
+// updated this frame are skipped. Returns the number of particles updated.
+int UpdateParticlesInRect(Grid& cells, int gridWidth, const DirtyRect& rect);
+
+// Updates the active particles listed in the chunk, from the bottom row to the top one, along
+// with the particles of the chunk that can follow a moving one. Particles already updated
+// this frame are skipped. Returns the number of particles updated.
+int UpdateActiveCells(Grid& cells, int gridWidth, int chunkIndex);
+
+// Updates the particles motion. Only the dirty rects of the awake chunks are visited,
+// or only their active particles depending on the step mode, so settled or empty areas
+// of the grid cost nothing. The chunks are spread over the
+// thread pool when one is given. Returns the number of particles updated.
+int UpdateParticleSimulation(Grid& cells, ThreadPool* pool);
@@ -0,0 +1,216 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "simulation_thread.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cstring>
+
+SimulationThread::SimulationThread(Grid& cells, ThreadPool& pool)
+    : cells(cells)
+    , pool(pool)
+    , chunkVersions(cells.chunks.size(), 1)
+{
+    for (GridSnapshot& snapshot : snapshots)
+    {
+        snapshot.width = cells.width;
+        snapshot.height = cells.height;
+        snapshot.chunksX = cells.chunksX;
+        snapshot.chunksY = cells.chunksY;
+        snapshot.materials.assign(cells.materials.size(), static_cast<uint8_t>(MaterialType::None));
+        snapshot.chunkVersions.assign(cells.chunks.size(), 0);
+    }
+
+    // The render thread gets the initial grid until the first step completes
+    PublishSnapshot();
+}
+
+SimulationThread::~SimulationThread()
+{
+    Stop();
+}
+
+void SimulationThread::Start()
+{
+    if (!thread.joinable())
+    {
+        shouldStop.store(false);
+        thread = std::thread([this]() { Run(); });
+    }
+}
+
+void SimulationThread::Stop()
+{
+    if (thread.joinable())
+    {
+        shouldStop.store(true);
+        thread.join();
+    }
+}
+
+void SimulationThread::PushCommand(const SimulationCommand& command)
+{
+    std::lock_guard<std::mutex> lock(commandMutex);
+    pendingCommands.push_back(command);
+}
+
+const GridSnapshot& SimulationThread::AcquireSnapshot()
+{
+    if (middleIndex.load(std::memory_order_relaxed) & SNAPSHOT_FRESH)
+    {
+        frontIndex = middleIndex.exchange(frontIndex, std::memory_order_acq_rel) & SNAPSHOT_INDEX_MASK;
+    }
+    return snapshots[frontIndex];
+}
+
+void SimulationThread::Run()
+{
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point nextTick = Clock::now();
+    int scheduledRate = 0;
+
+    SetTraceThreadName("Simulation");
+
+    while (!shouldStop.load(std::memory_order_relaxed))
+    {
+        const int rate = tickRate.load(std::memory_order_relaxed);
+        if (rate != scheduledRate)
+        {
+            // A new rate starts a new schedule, rather than catching up with the old one
+            scheduledRate = rate;
+            nextTick = Clock::now();
+        }
+
+        if (rate > 0)
+        {
+            const Clock::duration interval = std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(1000000000LL / rate));
+            const Clock::time_point now = Clock::now();
+
+            if (now < nextTick)
+            {
+                std::this_thread::sleep_until(nextTick);
+            }
+            else if (now - nextTick >= interval)
+            {
+                behindTickCount.fetch_add(1, std::memory_order_relaxed);
+
+                const long long missedTicks = (now - nextTick) / interval;
+                if (missedTicks > MAX_CATCH_UP_TICKS)
+                {
+                    droppedTickCount.fetch_add(static_cast<uint64_t>(missedTicks), std::memory_order_relaxed);
+                    nextTick = now;
+                }
+            }
+
+            nextTick += interval;
+        }
+
+        ApplyCommands();
+
+        // Steps until the budget runs out, at least once
+        ThreadPool* stepPool = useMultithreading.load(std::memory_order_relaxed) ? &pool : nullptr;
+        const std::chrono::duration<float, std::milli> budget(stepBudget.load(std::memory_order_relaxed));
+        const Clock::time_point tickStart = Clock::now();
+        int steps = 0;
+
+        do
+        {
+            UpdateParticleSimulation(cells, stepPool);
+            steps++;
+        } while (Clock::now() - tickStart < budget && !shouldStop.load(std::memory_order_relaxed));
+
+        const std::chrono::duration<float, std::milli> tickDuration = Clock::now() - tickStart;
+        tickMilliseconds.store(tickDuration.count(), std::memory_order_relaxed);
+        stepsPerTick.store(steps, std::memory_order_relaxed);
+        PublishSnapshot();
+
+        tickCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void SimulationThread::ApplyCommands()
+{
+    TraceZone zone("Commands");
+
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        commands.swap(pendingCommands);
+    }
+
+    for (const SimulationCommand& command : commands)
+    {
+        switch (command.type)
+        {
+        case SimulationCommand::Type::RevealParticle:
+            RevealParticleAt(cells, cells.width, command.x, command.y, command.materialType);
+            break;
+
+        case SimulationCommand::Type::RevealParticles:
+            RevealParticlesAt(cells, cells.width, command.bounds, command.materialType);
+            break;
+
+        case SimulationCommand::Type::SetBoundaryMode:
+            SetBoundaryMode(cells, command.boundaryMode);
+            break;
+
+        case SimulationCommand::Type::SetStepMode:
+            SetStepMode(cells, command.stepMode);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    commands.clear();
+}
+
+// Copies the chunks that changed since the back snapshot was last written, then swaps it
+// with the middle one, flagged as fresh for the render thread.
+void SimulationThread::PublishSnapshot()
+{
+    TraceZone zone("Publish snapshot");
+
+    for (size_t i = 0; i < cells.chunks.size(); i++)
+    {
+        if (cells.chunks[i].pixelsChanged.exchange(false, std::memory_order_relaxed))
+        {
+            chunkVersions[i]++;
+        }
+    }
+
+    GridSnapshot& snapshot = snapshots[backIndex];
+
+    for (int chunkY = 0; chunkY < cells.chunksY; chunkY++)
+    {
+        for (int chunkX = 0; chunkX < cells.chunksX; chunkX++)
+        {
+            const int chunkIndex = chunkY * cells.chunksX + chunkX;
+            if (snapshot.chunkVersions[chunkIndex] == chunkVersions[chunkIndex])
+            {
+                continue;
+            }
+
+            const int minX = chunkX * CHUNK_SIZE;
+            const int minY = chunkY * CHUNK_SIZE;
+            const int width = std::min(CHUNK_SIZE, cells.width - minX);
+            const int height = std::min(CHUNK_SIZE, cells.height - minY);
+
+            for (int y = minY; y < minY + height; y++)
+            {
+                const int rowIndex = GetCellIndex(cells.width, minX, y);
+                std::memcpy(&snapshot.materials[rowIndex], &cells.materials[rowIndex], width);
+            }
+
+            snapshot.chunkVersions[chunkIndex] = chunkVersions[chunkIndex];
+        }
+    }
+
+    snapshot.frame = cells.frame;
+    backIndex = middleIndex.exchange(backIndex | SNAPSHOT_FRESH, std::memory_order_acq_rel) & SNAPSHOT_INDEX_MASK;
+}
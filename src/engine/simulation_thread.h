@@ -0,0 +1,160 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "grid.h"
+#include "materials.h"
+#include "simulation.h"
+#include "thread_pool.h"
+
+// Ticks the simulation may run late before the missing ones are dropped instead of caught up.
+constexpr int MAX_CATCH_UP_TICKS = 5;
+
+// Materials of the grid as they were after a step, read by the render thread while the
+// simulation goes on. The materials have the same layout as in the grid.
+struct GridSnapshot
+{
+    int width = 0;
+    int height = 0;
+    int chunksX = 0;
+    int chunksY = 0;
+
+    std::vector<uint8_t> materials;
+    std::vector<uint32_t> chunkVersions; // Changes every time a chunk of the copy changes
+    uint32_t frame = 0; // Number of simulation steps the snapshot was taken after
+};
+
+// Change requested by another thread, applied by the simulation thread before its next step.
+struct SimulationCommand
+{
+    enum class Type
+    {
+        RevealParticle, // A particle of the material at x and y
+        RevealParticles, // Particles of the material in the bounds
+        SetBoundaryMode,
+        SetStepMode
+    };
+
+    Type type;
+    int x;
+    int y;
+    CellBounds bounds;
+    MaterialType materialType;
+    BoundaryMode boundaryMode;
+    StepMode stepMode;
+};
+
+// Steps the grid on its own thread at a fixed tick rate, independently from the display.
+// After each step, the changed chunks are copied into one of three snapshots. The render
+// thread always gets the latest completed one, and neither thread ever waits for the other.
+class SimulationThread
+{
+public:
+    // The grid and the pool belong to the simulation thread until it is stopped.
+    SimulationThread(Grid& cells, ThreadPool& pool);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    void Start();
+    void Stop();
+
+    // Ticks per second, 0 to step as fast as possible.
+    void SetTickRate(int ticksPerSecond)
+    {
+        tickRate.store(ticksPerSecond, std::memory_order_relaxed);
+    }
+
+    // Time in milliseconds each tick keeps stepping for, 0 for a single step per tick. Used
+    // to fast-forward a scene, the snapshot is only published once per tick.
+    void SetStepBudget(float milliseconds)
+    {
+        stepBudget.store(milliseconds, std::memory_order_relaxed);
+    }
+
+    void SetMultithreading(bool enabled)
+    {
+        useMultithreading.store(enabled, std::memory_order_relaxed);
+    }
+
+    void PushCommand(const SimulationCommand& command);
+
+    // Returns the latest completed snapshot. Must only be called from one thread, the
+    // snapshot stays untouched until the next call.
+    const GridSnapshot& AcquireSnapshot();
+
+    // Number of ticks run so far.
+    uint64_t GetTickCount() const
+    {
+        return tickCount.load(std::memory_order_relaxed);
+    }
+
+    // Number of steps run by the last tick.
+    int GetStepsPerTick() const
+    {
+        return stepsPerTick.load(std::memory_order_relaxed);
+    }
+
+    // Time in milliseconds the last tick spent stepping.
+    float GetTickMilliseconds() const
+    {
+        return tickMilliseconds.load(std::memory_order_relaxed);
+    }
+
+    // Number of ticks that started at least a tick later than scheduled.
+    uint64_t GetBehindTickCount() const
+    {
+        return behindTickCount.load(std::memory_order_relaxed);
+    }
+
+    // Number of scheduled ticks skipped after running more than MAX_CATCH_UP_TICKS late.
+    uint64_t GetDroppedTickCount() const
+    {
+        return droppedTickCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    // The middle snapshot index holds this bit while it has not been acquired yet
+    static constexpr int SNAPSHOT_FRESH = 1 << 2;
+    static constexpr int SNAPSHOT_INDEX_MASK = SNAPSHOT_FRESH - 1;
+
+    void Run();
+    void ApplyCommands();
+    void PublishSnapshot();
+
+    Grid& cells;
+    ThreadPool& pool;
+
+    std::thread thread;
+    std::atomic<bool> shouldStop{ false };
+    std::atomic<bool> useMultithreading{ false };
+    std::atomic<int> tickRate{ 60 };
+    std::atomic<float> stepBudget{ 0.0f };
+
+    std::mutex commandMutex;
+    std::vector<SimulationCommand> pendingCommands; // Pushed by other threads
+    std::vector<SimulationCommand> commands; // Being applied by the simulation thread
+
+    GridSnapshot snapshots[3];
+    int backIndex = 0; // Written by the simulation thread
+    std::atomic<int> middleIndex{ 1 }; // Last completed snapshot, swapped with the others
+    int frontIndex = 2; // Read by the render thread
+    std::vector<uint32_t> chunkVersions; // Current version of every chunk of the grid
+
+    std::atomic<uint64_t> tickCount{ 0 };
+    std::atomic<int> stepsPerTick{ 0 };
+    std::atomic<float> tickMilliseconds{ 0.0f };
+    std::atomic<uint64_t> behindTickCount{ 0 };
+    std::atomic<uint64_t> droppedTickCount{ 0 };
+};
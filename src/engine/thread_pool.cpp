@@ -0,0 +1,108 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "thread_pool.h"
+#include "trace.h"
+
+ThreadPool::ThreadPool(int threadCount)
+{
+    for (int i = 1; i < threadCount; i++)
+    {
+        workers.emplace_back([this]() { WorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shouldStop = true;
+    }
+    wakeCondition.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& task)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentTask = &task;
+        taskCount = count;
+        nextIndex = 0;
+        pendingCount = count;
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    RunTasks();
+
+    // Threads still holding the task must be done with it before it goes out of scope
+    TraceZone zone("Wait for workers");
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this]() { return pendingCount == 0 && activeCount == 0; });
+    currentTask = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+    unsigned int seenGeneration = 0;
+    SetTraceThreadName("Worker");
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&]() { return shouldStop || generation != seenGeneration; });
+            if (shouldStop)
+            {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        RunTasks();
+    }
+}
+
+void ThreadPool::RunTasks()
+{
+    const std::function<void(int)>* task;
+    int count;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!currentTask)
+        {
+            return;
+        }
+        task = currentTask;
+        count = taskCount;
+        activeCount++;
+    }
+
+    int done = 0;
+    for (int i = nextIndex.fetch_add(1); i < count; i = nextIndex.fetch_add(1))
+    {
+        (*task)(i);
+        done++;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingCount -= done;
+    activeCount--;
+    if (pendingCount == 0 && activeCount == 0)
+    {
+        doneCondition.notify_all();
+    }
+}
@@ -0,0 +1,51 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+// Fixed set of worker threads running the chunk updates in parallel.
+class ThreadPool
+{
+public:
+    // The calling thread takes part in the work too, so threadCount - 1 workers are spawned.
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int GetThreadCount() const
+    {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    // Calls task(i) for every i in [0, count) across the threads and returns once all calls are done.
+    void ParallelFor(int count, const std::function<void(int)>& task);
+
+private:
+    void WorkerLoop();
+    void RunTasks();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+
+    const std::function<void(int)>* currentTask = nullptr;
+    int taskCount = 0;
+    std::atomic<int> nextIndex{ 0 };
+    int pendingCount = 0;
+    int activeCount = 0;
+    unsigned int generation = 0;
+    bool shouldStop = false;
+};
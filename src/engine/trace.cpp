@@ -0,0 +1,222 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "trace.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+std::atomic<bool> traceEnabled{ false };
+
+struct TraceEvent
+{
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    int id;
+};
+
+// Zones of one thread. Only that thread writes to it, the mutex is there for the thread
+// writing the file, so it is almost never contended.
+struct TraceBuffer
+{
+    std::mutex mutex;
+    const char* threadName = nullptr;
+    int threadId = 0;
+    std::vector<TraceEvent> events; // Allocated on the first zone
+    uint64_t eventCount = 0; // Zones recorded since tracing was enabled, wraps over the events
+};
+
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<TraceBuffer>> buffers; // Kept after their thread exits
+static thread_local TraceBuffer* threadBuffer = nullptr;
+
+static std::mutex frameMutex;
+static uint64_t frameStarts[TRACE_MAX_FRAMES];
+static uint64_t recordedFrameCount = 0;
+
+// Returns the buffer of the calling thread, registered on its first use.
+static TraceBuffer& GetThreadBuffer()
+{
+    if (!threadBuffer)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers.emplace_back(new TraceBuffer());
+        threadBuffer = buffers.back().get();
+        threadBuffer->threadId = static_cast<int>(buffers.size()) - 1;
+    }
+    return *threadBuffer;
+}
+
+// --------------------------------------------------------------------------------------------
+
+void SetTraceEnabled(bool enabled)
+{
+    if (traceEnabled.exchange(enabled) || !enabled)
+    {
+        return;
+    }
+
+    // A new recording starts empty, rather than after a gap in the old one
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const std::unique_ptr<TraceBuffer>& buffer : buffers)
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            buffer->eventCount = 0;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(frameMutex);
+    recordedFrameCount = 0;
+}
+
+uint64_t GetTraceTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SetTraceThreadName(const char* name)
+{
+    TraceBuffer& buffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.threadName = name;
+}
+
+void TraceFrame()
+{
+    if (!IsTraceEnabled())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(frameMutex);
+    frameStarts[recordedFrameCount % TRACE_MAX_FRAMES] = GetTraceTime();
+    recordedFrameCount++;
+}
+
+void RecordTraceZone(const char* name, uint64_t start, uint64_t end, int id)
+{
+    TraceBuffer& buffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+
+    if (buffer.events.empty())
+    {
+        buffer.events.resize(TRACE_EVENTS_PER_THREAD);
+    }
+
+    buffer.events[buffer.eventCount % TRACE_EVENTS_PER_THREAD] = { name, start, end, id };
+    buffer.eventCount++;
+}
+
+// --------------------------------------------------------------------------------------------
+
+bool WriteTraceFile(const std::string& path, int frameCount)
+{
+    // Zones that ended before the first written frame started are left out
+    uint64_t cutTime = 0;
+    std::vector<uint64_t> frames;
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        const uint64_t keptFrames = std::min<uint64_t>(recordedFrameCount, static_cast<uint64_t>(std::max(0, std::min(frameCount, TRACE_MAX_FRAMES))));
+        for (uint64_t frame = recordedFrameCount - keptFrames; frame < recordedFrameCount; frame++)
+        {
+            frames.push_back(frameStarts[frame % TRACE_MAX_FRAMES]);
+        }
+        if (!frames.empty())
+        {
+            cutTime = frames.front();
+        }
+    }
+
+    struct ThreadEvents
+    {
+        const char* name;
+        int id;
+        std::vector<TraceEvent> events;
+    };
+
+    std::vector<ThreadEvents> threads;
+    uint64_t firstTime = UINT64_MAX;
+    size_t eventCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const std::unique_ptr<TraceBuffer>& buffer : buffers)
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            ThreadEvents thread = { buffer->threadName, buffer->threadId, {} };
+
+            const uint64_t keptEvents = std::min<uint64_t>(buffer->eventCount, TRACE_EVENTS_PER_THREAD);
+            for (uint64_t i = buffer->eventCount - keptEvents; i < buffer->eventCount; i++)
+            {
+                const TraceEvent& event = buffer->events[i % TRACE_EVENTS_PER_THREAD];
+                if (event.end >= cutTime)
+                {
+                    thread.events.push_back(event);
+                    firstTime = std::min(firstTime, event.start);
+                }
+            }
+
+            eventCount += thread.events.size();
+            threads.push_back(std::move(thread));
+        }
+    }
+
+    if (eventCount == 0)
+    {
+        std::cout << "The trace is empty, enable tracing before writing it" << std::endl;
+        return false;
+    }
+
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cout << "Could not open " << path << std::endl;
+        return false;
+    }
+
+    // Timestamps are in microseconds from the first zone written
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+    for (const ThreadEvents& thread : threads)
+    {
+        file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread.id
+             << ", \"args\": {\"name\": \"" << (thread.name ? thread.name : "Thread") << " " << thread.id << "\"}},\n";
+
+        for (const TraceEvent& event : thread.events)
+        {
+            file << "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread.id
+                 << ", \"ts\": " << (event.start - firstTime) / 1000.0 << ", \"dur\": " << (event.end - event.start) / 1000.0;
+            if (event.id >= 0)
+            {
+                file << ", \"args\": {\"id\": " << event.id << "}";
+            }
+            file << "},\n";
+        }
+    }
+
+    for (uint64_t frameStart : frames)
+    {
+        if (frameStart >= firstTime)
+        {
+            file << "{\"name\": \"Frame\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, \"tid\": 0, \"ts\": " << (frameStart - firstTime) / 1000.0 << "},\n";
+        }
+    }
+
+    // Closes the list without a trailing comma
+    file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"Particle simulation\"}}\n";
+    file << "]}\n";
+
+    std::cout << "Wrote " << eventCount << " zones to " << path << std::endl;
+    return true;
+}
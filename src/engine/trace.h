@@ -0,0 +1,72 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Timed zones recorded by every thread into its own ring buffer, then written as a Chrome
+// trace that chrome://tracing and ui.perfetto.dev can open. Recording is off by default, a
+// zone then costs a single relaxed load.
+
+constexpr int TRACE_EVENTS_PER_THREAD = 1 << 16; // Oldest zones of a thread are overwritten first
+constexpr int TRACE_MAX_FRAMES = 240; // Frame starts remembered to cut the trace at
+
+extern std::atomic<bool> traceEnabled;
+
+inline bool IsTraceEnabled()
+{
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+void SetTraceEnabled(bool enabled);
+
+// Returns the current time in nanoseconds, on the clock the zones are recorded with.
+uint64_t GetTraceTime();
+
+// Names the calling thread in the trace. The name must outlive the trace.
+void SetTraceThreadName(const char* name);
+
+// Marks the start of a frame on the calling thread, the trace is cut at these marks.
+void TraceFrame();
+
+// Records a zone of the calling thread. The name must outlive the trace, id is shown with
+// the zone when not negative.
+void RecordTraceZone(const char* name, uint64_t start, uint64_t end, int id = -1);
+
+// Writes the zones of the last frameCount frames of every thread. Returns false and prints
+// the error if nothing was recorded or the file cannot be written.
+bool WriteTraceFile(const std::string& path, int frameCount = TRACE_MAX_FRAMES);
+
+// Records the time between its construction and its destruction as a zone.
+class TraceZone
+{
+public:
+    explicit TraceZone(const char* name, int id = -1)
+        : name(name)
+        , id(id)
+        , start(IsTraceEnabled() ? GetTraceTime() : 0)
+    {
+    }
+
+    ~TraceZone()
+    {
+        if (start != 0)
+        {
+            RecordTraceZone(name, start, GetTraceTime(), id);
+        }
+    }
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+    const char* name;
+    int id;
+    uint64_t start;
+};
@@ -0,0 +1,273 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "grid_renderer.h"
+#include "engine/simd.h"
+
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+float GetPixelsPerCell(const Camera& camera)
+{
+    return std::ldexp(static_cast<float>(camera.cellSize), camera.zoom);
+}
+
+int GetMipLevel(const Camera& camera)
+{
+    const float pixelsPerCell = GetPixelsPerCell(camera);
+
+    int level = 0;
+    while (level < MAX_MIP_LEVEL && pixelsPerCell * (1 << level) < 1.0f)
+    {
+        level++;
+    }
+    return level;
+}
+
+int GetVisibleColumns(const Camera& camera, int gridWidth)
+{
+    const int columns = static_cast<int>(std::ceil(camera.viewWidth / GetPixelsPerCell(camera)));
+    return std::max(1, std::min(columns, gridWidth));
+}
+
+int GetVisibleRows(const Camera& camera, int gridHeight)
+{
+    const int rows = static_cast<int>(std::ceil(camera.viewHeight / GetPixelsPerCell(camera)));
+    return std::max(1, std::min(rows, gridHeight));
+}
+
+SDL_Point ScreenToCell(const Camera& camera, int screenX, int screenY)
+{
+    const float pixelsPerCell = GetPixelsPerCell(camera);
+    return SDL_Point{ camera.x + static_cast<int>(std::floor(screenX / pixelsPerCell)),
+                      camera.y + static_cast<int>(std::floor(screenY / pixelsPerCell)) };
+}
+
+void MoveCamera(Camera& camera, int deltaX, int deltaY, int gridWidth, int gridHeight)
+{
+    camera.x = std::max(0, std::min(camera.x + deltaX, gridWidth - GetVisibleColumns(camera, gridWidth)));
+    camera.y = std::max(0, std::min(camera.y + deltaY, gridHeight - GetVisibleRows(camera, gridHeight)));
+}
+
+void ZoomCamera(Camera& camera, int delta, int screenX, int screenY, int gridWidth, int gridHeight)
+{
+    const SDL_Point pivot = ScreenToCell(camera, screenX, screenY);
+
+    for (; delta > 0 && camera.zoom < MAX_ZOOM; delta--)
+    {
+        camera.zoom++;
+    }
+
+    for (; delta < 0; delta++)
+    {
+        const bool wholeGridVisible = GetVisibleColumns(camera, gridWidth) >= gridWidth && GetVisibleRows(camera, gridHeight) >= gridHeight;
+        if (wholeGridVisible || (GetMipLevel(camera) == MAX_MIP_LEVEL && GetPixelsPerCell(camera) * (1 << MAX_MIP_LEVEL) < 2.0f))
+        {
+            break;
+        }
+        camera.zoom--;
+    }
+
+    // The pivot cell stays under the same pixel
+    const float pixelsPerCell = GetPixelsPerCell(camera);
+    camera.x = pivot.x - static_cast<int>(screenX / pixelsPerCell);
+    camera.y = pivot.y - static_cast<int>(screenY / pixelsPerCell);
+    MoveCamera(camera, 0, 0, gridWidth, gridHeight);
+}
+
+// --------------------------------------------------------------------------------------------
+
+// Returns the per channel average of the four ARGB8888 colors. Channels are summed two at
+// a time, each in its own 16 bits lane.
+static uint32_t AverageColors(uint32_t color0, uint32_t color1, uint32_t color2, uint32_t color3)
+{
+    const uint32_t mask = 0x00ff00ffu;
+    const uint32_t blueRed = ((color0 & mask) + (color1 & mask) + (color2 & mask) + (color3 & mask)) >> 2;
+    const uint32_t greenAlpha = (((color0 >> 8) & mask) + ((color1 >> 8) & mask) + ((color2 >> 8) & mask) + ((color3 >> 8) & mask)) >> 2;
+    return (blueRed & mask) | ((greenAlpha & mask) << 8);
+}
+
+// Downsamples the cells of the chunk into every mip level. A level is built from the
+// previous one, so a chunk costs about a third more than its cells. Texels covering cells
+// outside of the grid repeat the last row and column.
+static void UpdateChunkMips(GridRenderer& gridRenderer, const GridSnapshot& cells, int chunkX, int chunkY)
+{
+    const uint32_t* palette = GetMaterialPalette();
+
+    for (int level = 1; level <= MAX_MIP_LEVEL; level++)
+    {
+        std::vector<uint32_t>& mip = gridRenderer.mips[level - 1];
+        const int mipWidth = gridRenderer.mipWidths[level - 1];
+        const int mipHeight = gridRenderer.mipHeights[level - 1];
+
+        const int texelsPerChunk = CHUNK_SIZE >> level;
+        const int minX = chunkX * texelsPerChunk;
+        const int minY = chunkY * texelsPerChunk;
+        const int maxX = std::min(minX + texelsPerChunk, mipWidth);
+        const int maxY = std::min(minY + texelsPerChunk, mipHeight);
+
+        // Size of the level the texels are built from
+        const int sourceWidth = level == 1 ? cells.width : gridRenderer.mipWidths[level - 2];
+        const int sourceHeight = level == 1 ? cells.height : gridRenderer.mipHeights[level - 2];
+
+        for (int y = minY; y < maxY; y++)
+        {
+            const int y0 = y * 2;
+            const int y1 = std::min(y0 + 1, sourceHeight - 1);
+
+            for (int x = minX; x < maxX; x++)
+            {
+                const int x0 = x * 2;
+                const int x1 = std::min(x0 + 1, sourceWidth - 1);
+
+                if (level == 1)
+                {
+                    mip[y * mipWidth + x] = AverageColors(palette[cells.materials[GetCellIndex(cells.width, x0, y0)]],
+                                                          palette[cells.materials[GetCellIndex(cells.width, x1, y0)]],
+                                                          palette[cells.materials[GetCellIndex(cells.width, x0, y1)]],
+                                                          palette[cells.materials[GetCellIndex(cells.width, x1, y1)]]);
+                }
+                else
+                {
+                    const std::vector<uint32_t>& source = gridRenderer.mips[level - 2];
+                    mip[y * mipWidth + x] = AverageColors(source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1],
+                                                          source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1]);
+                }
+            }
+        }
+    }
+}
+
+bool InitGridRenderer(GridRenderer& gridRenderer, SDL_Renderer* renderer, const GridSnapshot& cells, int viewWidth, int viewHeight)
+{
+    // Cells must stay sharp squares once the texture is scaled up
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+
+    // Texels are never smaller than a pixel, a partly visible one may stick out on each side
+    gridRenderer.textureWidth = std::min(viewWidth + 2, cells.width);
+    gridRenderer.textureHeight = std::min(viewHeight + 2, cells.height);
+    gridRenderer.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                             gridRenderer.textureWidth, gridRenderer.textureHeight);
+
+    if (!gridRenderer.texture)
+    {
+        std::cout << "Grid texture creation failed: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    for (int level = 1; level <= MAX_MIP_LEVEL; level++)
+    {
+        const int mipWidth = (cells.width + (1 << level) - 1) >> level;
+        const int mipHeight = (cells.height + (1 << level) - 1) >> level;
+        gridRenderer.mipWidths.push_back(mipWidth);
+        gridRenderer.mipHeights.push_back(mipHeight);
+        gridRenderer.mips.emplace_back(mipWidth * mipHeight, 0);
+    }
+
+    gridRenderer.mipsStale.assign(cells.chunkVersions.size(), 1);
+    gridRenderer.drawnVersions.assign(cells.chunkVersions.size(), 0);
+    gridRenderer.chunkPixels.resize(CHUNK_SIZE * CHUNK_SIZE);
+    return true;
+}
+
+void RenderParticles(GridRenderer& gridRenderer, SDL_Renderer* renderer, const GridSnapshot& cells, const Camera& camera)
+{
+    const uint32_t* palette = GetMaterialPalette();
+    const int level = GetMipLevel(camera);
+
+    const Camera& uploaded = gridRenderer.uploadedCamera;
+    const bool cameraChanged = !gridRenderer.hasUploaded || camera.x != uploaded.x || camera.y != uploaded.y || camera.zoom != uploaded.zoom;
+    gridRenderer.uploadedCamera = camera;
+    gridRenderer.hasUploaded = true;
+
+    // Visible cells, then the texels of the level covering them
+    const int viewMaxX = camera.x + GetVisibleColumns(camera, cells.width) - 1;
+    const int viewMaxY = camera.y + GetVisibleRows(camera, cells.height) - 1;
+    const int texelMinX = camera.x >> level;
+    const int texelMinY = camera.y >> level;
+    const int texelMaxX = std::min(viewMaxX >> level, texelMinX + gridRenderer.textureWidth - 1);
+    const int texelMaxY = std::min(viewMaxY >> level, texelMinY + gridRenderer.textureHeight - 1);
+
+    for (int chunkY = camera.y / CHUNK_SIZE; chunkY <= viewMaxY / CHUNK_SIZE; chunkY++)
+    {
+        for (int chunkX = camera.x / CHUNK_SIZE; chunkX <= viewMaxX / CHUNK_SIZE; chunkX++)
+        {
+            const int chunkIndex = chunkY * cells.chunksX + chunkX;
+            const bool chunkChanged = gridRenderer.drawnVersions[chunkIndex] != cells.chunkVersions[chunkIndex];
+            if (chunkChanged)
+            {
+                gridRenderer.drawnVersions[chunkIndex] = cells.chunkVersions[chunkIndex];
+                gridRenderer.mipsStale[chunkIndex] = 1;
+            }
+
+            if (!chunkChanged && !cameraChanged)
+            {
+                continue;
+            }
+
+            if (level > 0 && gridRenderer.mipsStale[chunkIndex])
+            {
+                UpdateChunkMips(gridRenderer, cells, chunkX, chunkY);
+                gridRenderer.mipsStale[chunkIndex] = 0;
+            }
+
+            // Visible texels of the chunk, chunks always hold whole texels
+            const int texelsPerChunk = CHUNK_SIZE >> level;
+            const int minX = std::max(chunkX * texelsPerChunk, texelMinX);
+            const int minY = std::max(chunkY * texelsPerChunk, texelMinY);
+            const int maxX = std::min(chunkX * texelsPerChunk + texelsPerChunk - 1, texelMaxX);
+            const int maxY = std::min(chunkY * texelsPerChunk + texelsPerChunk - 1, texelMaxY);
+            if (minX > maxX || minY > maxY)
+            {
+                continue;
+            }
+
+            SDL_Rect rect;
+            rect.x = minX - texelMinX;
+            rect.y = minY - texelMinY;
+            rect.w = maxX - minX + 1;
+            rect.h = maxY - minY + 1;
+
+            if (level == 0)
+            {
+                for (int y = 0; y < rect.h; y++)
+                {
+                    const uint8_t* row = &cells.materials[GetCellIndex(cells.width, minX, minY + y)];
+                    ConvertMaterialsToPixels(row, &gridRenderer.chunkPixels[y * CHUNK_SIZE], rect.w, palette);
+                }
+
+                SDL_UpdateTexture(gridRenderer.texture, &rect, gridRenderer.chunkPixels.data(), CHUNK_SIZE * sizeof(uint32_t));
+            }
+            else
+            {
+                const int mipWidth = gridRenderer.mipWidths[level - 1];
+                const uint32_t* texels = &gridRenderer.mips[level - 1][minY * mipWidth + minX];
+                SDL_UpdateTexture(gridRenderer.texture, &rect, texels, mipWidth * static_cast<int>(sizeof(uint32_t)));
+            }
+        }
+    }
+
+    // The first texel may start left of or above the camera when zoomed out
+    const float texelPixels = GetPixelsPerCell(camera) * (1 << level);
+    const SDL_Rect source = { 0, 0, texelMaxX - texelMinX + 1, texelMaxY - texelMinY + 1 };
+
+    SDL_Rect destination;
+    destination.x = static_cast<int>(std::floor(((texelMinX << level) - camera.x) * GetPixelsPerCell(camera)));
+    destination.y = static_cast<int>(std::floor(((texelMinY << level) - camera.y) * GetPixelsPerCell(camera)));
+    destination.w = static_cast<int>(std::ceil(source.w * texelPixels));
+    destination.h = static_cast<int>(std::ceil(source.h * texelPixels));
+    SDL_RenderCopy(renderer, gridRenderer.texture, &source, &destination);
+}
+
+void DestroyGridRenderer(GridRenderer& gridRenderer)
+{
+    if (gridRenderer.texture)
+    {
+        SDL_DestroyTexture(gridRenderer.texture);
+        gridRenderer.texture = nullptr;
+    }
+}
@@ -0,0 +1,86 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "engine/grid.h"
+#include "engine/simulation_thread.h"
+
+constexpr int MAX_ZOOM = 3; // A cell is at most 8 times its configured size
+constexpr int MAX_MIP_LEVEL = 6; // A whole chunk is a single texel at the last level
+
+static_assert((CHUNK_SIZE >> MAX_MIP_LEVEL) >= 1, "Texels of every mip level must stay within a chunk");
+
+// Part of the grid seen through the window.
+struct Camera
+{
+    int x = 0; // Leftmost visible column
+    int y = 0; // Topmost visible row
+    int zoom = 0; // A cell is cellSize * 2^zoom pixels wide, negative values zoom out
+    int cellSize = 1; // Size in pixels of a cell at zoom 0
+    int viewWidth = 0; // Size in pixels of the window
+    int viewHeight = 0;
+};
+
+// Returns the size in pixels of a cell seen through the camera.
+float GetPixelsPerCell(const Camera& camera);
+
+// Returns the mip level drawn at the zoom of the camera, the first one with texels of at
+// least one pixel.
+int GetMipLevel(const Camera& camera);
+
+// Returns the number of columns of the grid seen through the camera.
+int GetVisibleColumns(const Camera& camera, int gridWidth);
+
+// Returns the number of rows of the grid seen through the camera.
+int GetVisibleRows(const Camera& camera, int gridHeight);
+
+// Returns the cell under the screen coordinates, which may be outside of the grid.
+SDL_Point ScreenToCell(const Camera& camera, int screenX, int screenY);
+
+// Moves the camera by the number of cells, without leaving the grid.
+void MoveCamera(Camera& camera, int deltaX, int deltaY, int gridWidth, int gridHeight);
+
+// Zooms in for a positive delta, out for a negative one, keeping the cell under the
+// screen coordinates in place. Zooming out stops once the whole grid is visible.
+void ZoomCamera(Camera& camera, int delta, int screenX, int screenY, int gridWidth, int gridHeight);
+
+// --------------------------------------------------------------------------------------------
+
+// Draws the grid through a camera. Only the cells inside the camera are ever read. When
+// zoomed out, the colors come from downsampled copies of the grid, the mip levels, so
+// the drawing cost is bounded by the pixels of the window and not by the cells.
+struct GridRenderer
+{
+    SDL_Texture* texture = nullptr; // Visible texels of the drawn mip level
+    int textureWidth = 0;
+    int textureHeight = 0;
+
+    std::vector<std::vector<uint32_t>> mips; // ARGB8888 colors of levels 1 to MAX_MIP_LEVEL
+    std::vector<int> mipWidths;
+    std::vector<int> mipHeights;
+    std::vector<uint8_t> mipsStale; // Per chunk, 1 if the mips do not match the cells
+    std::vector<uint32_t> drawnVersions; // Per chunk, version of the snapshot chunk last read
+
+    std::vector<uint32_t> chunkPixels; // Level 0 pixels of a chunk before upload
+
+    Camera uploadedCamera; // Camera the texture was last filled for
+    bool hasUploaded = false;
+};
+
+// Returns false and prints the error if the texture could not be created.
+bool InitGridRenderer(GridRenderer& gridRenderer, SDL_Renderer* renderer, const GridSnapshot& cells, int viewWidth, int viewHeight);
+
+// Uploads the visible chunks of the snapshot that changed since the last call, or every
+// visible chunk once the camera moved or zoomed, then draws them with a single copy.
+void RenderParticles(GridRenderer& gridRenderer, SDL_Renderer* renderer, const GridSnapshot& cells, const Camera& camera);
+
+void DestroyGridRenderer(GridRenderer& gridRenderer);
@@ -0,0 +1,253 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+// Runs the simulation without any window, renderer or frame delay and reports
+// the raw number of steps per second.
+//
+// Usage: particle-headless [--width N] [--height N] [--steps N] [--threads N] [--scene NAME] [--seed N]
+//                          [--boundary solid|wrap|open] [--step-mode rects|active|sand-bits] [--trace FILE]
+//                          [--simd scalar|sse2|avx2|avx512] [--benchmark-threads]
+//
+// --trace FILE records the last steps and writes them as a Chrome trace on exit.
+// --simd limits the vectorized kernels to an older instruction set than the CPU supports.
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include "engine/grid.h"
+#include "engine/materials.h"
+#include "engine/parse.h"
+#include "engine/scenes.h"
+#include "engine/simd.h"
+#include "engine/simulation.h"
+#include "engine/thread_pool.h"
+#include "engine/trace.h"
+
+struct HeadlessOptions
+{
+    int gridWidth = 1024;
+    int gridHeight = 1024;
+    int stepCount = 500;
+    int threadCount = 1;
+    std::string sceneName = "sand-and-water";
+    unsigned int seed = 1234;
+    BoundaryMode boundaryMode = BoundaryMode::Solid;
+    StepMode stepMode = StepMode::Rects;
+    std::string tracePath; // Empty to not trace
+    SimdPath simdPath = SimdPath::Count; // Count to use the fastest path the CPU supports
+    bool benchmarkThreads = false;
+};
+
+// Returns false and prints the usage if an argument is not recognized.
+bool ParseArguments(int argc, char* argv[], HeadlessOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (argument == "--width" && hasValue)
+        {
+            if (!ParseInt(argv[++i], options.gridWidth))
+            {
+                std::cout << "--width expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--height" && hasValue)
+        {
+            if (!ParseInt(argv[++i], options.gridHeight))
+            {
+                std::cout << "--height expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--steps" && hasValue)
+        {
+            if (!ParseInt(argv[++i], options.stepCount))
+            {
+                std::cout << "--steps expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--threads" && hasValue)
+        {
+            if (!ParseInt(argv[++i], options.threadCount))
+            {
+                std::cout << "--threads expects a whole number, not " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--scene" && hasValue)
+        {
+            options.sceneName = argv[++i];
+        }
+        else if (argument == "--seed" && hasValue)
+        {
+            options.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (argument == "--boundary" && hasValue)
+        {
+            if (!ParseBoundaryMode(argv[++i], options.boundaryMode))
+            {
+                std::cout << "Unknown boundary mode " << argv[i] << ", expected solid, wrap or open" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--step-mode" && hasValue)
+        {
+            if (!ParseStepMode(argv[++i], options.stepMode))
+            {
+                std::cout << "Unknown step mode " << argv[i] << ", expected rects, active or sand-bits" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--trace" && hasValue)
+        {
+            options.tracePath = argv[++i];
+        }
+        else if (argument == "--simd" && hasValue)
+        {
+            if (!ParseSimdPath(argv[++i], options.simdPath))
+            {
+                std::cout << "Unknown SIMD path " << argv[i] << ", expected scalar, sse2, avx2 or avx512" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--benchmark-threads")
+        {
+            options.benchmarkThreads = true;
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--width N] [--height N] [--steps N] [--threads N]"
+                      << " [--scene NAME] [--seed N] [--boundary solid|wrap|open] [--step-mode rects|active|sand-bits] [--trace FILE] [--simd scalar|sse2|avx2|avx512] [--benchmark-threads]" << std::endl;
+            return false;
+        }
+    }
+
+    if (options.gridWidth <= 0 || options.gridHeight <= 0 || options.stepCount <= 0 || options.threadCount <= 0)
+    {
+        std::cout << "Grid size, step count and thread count must be positive" << std::endl;
+        return false;
+    }
+
+    if (!GridSizeFits(options.gridWidth, options.gridHeight))
+    {
+        std::cout << "The grid is too large, it must hold at most " << INT_MAX << " cells border included" << std::endl;
+        return false;
+    }
+
+    if (!FindScene(options.sceneName))
+    {
+        std::cout << "Unknown scene " << options.sceneName << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Steps the scene and returns the number of steps per second reached.
+double MeasureStepsPerSecond(const HeadlessOptions& options, int threadCount)
+{
+    Grid cells(options.gridWidth, options.gridHeight);
+    cells.seed = options.seed;
+    SetBoundaryMode(cells, options.boundaryMode);
+    SetStepMode(cells, options.stepMode);
+    FindScene(options.sceneName)->fill(cells, options.gridWidth, options.gridHeight, options.seed);
+
+    ThreadPool pool(threadCount);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < options.stepCount; step++)
+    {
+        TraceFrame();
+        UpdateParticleSimulation(cells, &pool);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return options.stepCount / elapsed.count();
+}
+
+// Steps the same scene with an increasing number of threads and prints the
+// steps per second reached by each, along with the speedup over one thread.
+void RunThreadBenchmark(const HeadlessOptions& options)
+{
+    // Powers of two up to the number of hardware threads, which is always measured
+    const int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<int> threadCounts;
+    for (int threadCount = 1; threadCount < maxThreads; threadCount *= 2)
+    {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(maxThreads);
+
+    double baseStepsPerSecond = 0.0;
+
+    std::cout << "threads,steps_per_second,speedup" << std::endl;
+
+    for (int threadCount : threadCounts)
+    {
+        const double stepsPerSecond = MeasureStepsPerSecond(options, threadCount);
+        if (threadCount == 1)
+        {
+            baseStepsPerSecond = stepsPerSecond;
+        }
+
+        std::cout << threadCount << "," << stepsPerSecond << "," << stepsPerSecond / baseStepsPerSecond << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    HeadlessOptions options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        return -1;
+    }
+
+    InitMaterialTable();
+
+    if (options.simdPath != SimdPath::Count && SetSimdPath(options.simdPath) != options.simdPath)
+    {
+        std::cout << "The CPU does not support " << GetSimdPathName(options.simdPath) << ", using " << GetSimdPathName(GetSimdPath()) << std::endl;
+    }
+
+    if (!options.tracePath.empty())
+    {
+        SetTraceThreadName("Main");
+        SetTraceEnabled(true);
+    }
+
+    if (options.benchmarkThreads)
+    {
+        RunThreadBenchmark(options);
+    }
+    else
+    {
+        const double stepsPerSecond = MeasureStepsPerSecond(options, options.threadCount);
+
+        std::cout << "Scene: " << options.sceneName << ", " << GetBoundaryModeName(options.boundaryMode) << " boundary, "
+                  << GetStepModeName(options.stepMode) << " step mode" << std::endl;
+        std::cout << "Grid: " << options.gridWidth << "x" << options.gridHeight << " cells, "
+                  << options.stepCount << " steps, " << options.threadCount << " threads" << std::endl;
+        std::cout << "SIMD path: " << GetSimdPathName(GetSimdPath()) << " (" << GetSimdPathName(GetSupportedSimdPath()) << " supported)" << std::endl;
+        std::cout << "Steps per second: " << stepsPerSecond << std::endl;
+    }
+
+    if (!options.tracePath.empty() && !WriteTraceFile(options.tracePath))
+    {
+        return -1;
+    }
+
+    return 0;
+}
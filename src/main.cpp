@@ -4,12 +4,13 @@
  * C++14, Visual Studio 2022.                                               *
 \****************************************************************************/
 
-#include <cmath>
-#include <string>
+#include <cstdint>
 #include <random>
+#include <string>
+#include <algorithm>
+#include <thread>
 #include <vector>
 #include <iostream>
-#include <unordered_map>
 
 #include <imgui.h>
 #include <imgui_stdlib.h> // ImGui with std::string
@@ -19,24 +20,20 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_mixer.h>
 
-#undef main
+#include "config.h"
+#include "grid_renderer.h"
+#include "perf_hud.h"
+#include "engine/grid.h"
+#include "engine/materials.h"
+#include "engine/simulation.h"
+#include "engine/simulation_thread.h"
+#include "engine/thread_pool.h"
+#include "engine/trace.h"
 
-constexpr int CELL_SIZE = 10;
-constexpr int WINDOW_HEIGHT = 700;
-constexpr int WINDOW_WIDTH = 700;
+#undef main
 
 // --------------------------------------------------------------------------------------------
 
-enum class MaterialType
-{
-    None, // Used to represent an empty cell/particle
-    Sand,
-    Water,
-    Lava,
-    Acid,
-    ToxicGas
-};
-
 enum class BrushType
 {
     Small  = 1, // Reveal a single particle at once
@@ -44,146 +41,23 @@ enum class BrushType
     Big    = 16 // Reveal particles in located in a rect with an extent of 16
 };
 
+constexpr const char* TRACE_FILE_NAME = "trace.json"; // Saved in the working directory by F9
+
 static BrushType selectedBrushType = BrushType::Small;
 static MaterialType selectedMaterialType = MaterialType::Sand;
+static bool useMultithreading = false;
+static int tickRate = 60; // Simulation ticks per second, 0 for as many as possible
+static float stepBudget = 0.0f; // Milliseconds each tick keeps stepping for, to fast-forward
+static float stepsPerFrame = 0.0f; // Rolling average of the steps shown by each rendered frame
+static BoundaryMode selectedBoundaryMode = BoundaryMode::Solid;
+static StepMode selectedStepMode = StepMode::Rects;
+static Camera camera;
+static PerfHud perfHud;
 
 // --------------------------------------------------------------------------------------------
 
-struct SpreadRules
-{
-    int spreadSpeed;
-    std::vector<MaterialType> canReplace;
-    std::unordered_map<MaterialType, SDL_Color> contactColors;
-};
-
-struct Particle
-{
-    float lifeTime;
-    bool hasBeenUpdatedThisFrame;
-    SpreadRules spreadRules;
-    MaterialType materialType;
-
-    Particle() = delete;
-    Particle(const SpreadRules& spreadRules)
-        : lifeTime(-1.0f)
-        , hasBeenUpdatedThisFrame(false)
-        , spreadRules(spreadRules)
-        , materialType(MaterialType::None)
-    {
-    }
-};
-
-using Grid = std::vector<Particle>;
-
-// --------------------------------------------------------------------------------------------
-
-static std::default_random_engine rng;
-static std::random_device rd;
-static std::mt19937 gen(rd());
-
-// Function to generate a random float between min and max (inclusive)
-float RandomFloat(float min, float max)
-{
-    std::uniform_real_distribution<float> dis(min, max);
-    return dis(gen);
-}
-
-// --------------------------------------------------------------------------------------------
-
-SpreadRules GetParticleSpreadRules(MaterialType materialType)
-{
-    SpreadRules rules;
-    switch (materialType)
-    {
-    case MaterialType::None:
-        rules = { 1, { MaterialType::None }, { { MaterialType::None, { 0, 0, 0, 255 } } } };
-        break;
-
-    case MaterialType::Sand:
-        rules = { 1, { MaterialType::None, MaterialType::Water }, { { MaterialType::None, { 255, 255, 0, 255 } }, { MaterialType::Water, { 255, 255, 0, 255 } } } };
-        break;
-
-    case MaterialType::Water:
-        rules = { 1, { MaterialType::None, MaterialType::Lava }, { { MaterialType::None, { 0, 0, 255, 255 } }, { MaterialType::Lava, { 230, 230, 0, 255 } } } };
-        break;
-
-    case MaterialType::Lava:
-        rules = { 1, { MaterialType::None }, { { MaterialType::None, { 255, 0, 0, 255 } } } };
-        break;
-
-    case MaterialType::Acid:
-        rules = { 1, { MaterialType::None }, { { MaterialType::None, { 88, 212, 0, 255 } } } };
-        break;
-
-    case MaterialType::ToxicGas:
-        rules = { 1, { MaterialType::None }, { { MaterialType::None, { 220, 220, 220, 255 } } } };
-        break;
-
-    default:
-        break;
-    }
-
-    return rules;
-}
-
-// --------------------------------------------------------------------------------------------
-
-// Returns a new rgb color as an SDL_Color struct that the particle p should
-// take when in collides with the material with type.
-SDL_Color GetParticleColorOnCollision(const Particle& particle, const Particle& target)
-{
-    const auto& contactColors = particle.spreadRules.contactColors;
-
-    auto it = contactColors.find(target.materialType);
-    if (it != contactColors.end())
-    {
-        return it->second;
-    }
-
-    return SDL_Color{ 0, 0, 0, 255 };
-}
-
-// --------------------------------------------------------------------------------------------
-
-// Returns the index in the list of the cell located at x and y.
-int GetCellIndex(int gridWidth, int x, int y)
-{
-    return y * gridWidth + x;
-}
-
-// --------------------------------------------------------------------------------------------
-
-// Returns true if the particle p is allowed to replace the material type.
-bool ParticleCanReplace(const Particle& particle, const Particle& target)
-{
-    const auto& spreadRules = particle.spreadRules;
-    const auto& canReplace = spreadRules.canReplace;
-
-    auto it = std::find(canReplace.begin(), canReplace.end(), target.materialType);
-
-    if (it != canReplace.end())
-    {
-        return true;
-    }
-
-    return false;
-}
-
-// Returns wether the cell located at x and y on the grid is empty or not.
-bool CellIsEmpty(const Grid& cells, int gridWidth, int x, int y)
-{
-    int index = GetCellIndex(x, y, gridWidth);
-    return cells[index].materialType == MaterialType::None;
-}
-
-// Returns wether the cell located at x and y on the grid is empty or not.
-bool ParticleIsEmpty(const Particle& particle)
-{
-    return particle.materialType == MaterialType::None;
-}
-
 // Returns true on full success.
-bool InitSDL(SDL_Window*& window, SDL_Renderer*& renderer)
+bool InitSDL(SDL_Window*& window, SDL_Renderer*& renderer, int windowWidth, int windowHeight)
 {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
     {
@@ -194,8 +68,8 @@ bool InitSDL(SDL_Window*& window, SDL_Renderer*& renderer)
     window = SDL_CreateWindow("Particle simulation",
                                SDL_WINDOWPOS_UNDEFINED,
                                SDL_WINDOWPOS_UNDEFINED,
-                               WINDOW_WIDTH,
-                               WINDOW_HEIGHT,
+                               windowWidth,
+                               windowHeight,
                                SDL_WINDOW_SHOWN);
 
     if (!window)
@@ -239,51 +113,29 @@ bool InitImGui(SDL_Window* window, SDL_Renderer* renderer)
 
 // --------------------------------------------------------------------------------------------
 
-// Returns a rect based on the cell located at x and y on the grid.
-SDL_Rect CellToRect(int x, int y, int cellSize)
+// Transforms a mouse coordinates tuple to a rect bounds accordingly to the grid seen through the camera.
+CellBounds MouseCoordinatesToBounds(int gridWidth, int gridHeight, const Camera& view, int mouseX, int mouseY, int extent)
 {
-    SDL_Rect ret;
-    ret.x = x * cellSize;
-    ret.y = y * cellSize;
-    ret.w = cellSize;
-    ret.h = cellSize;
-    return ret;
-}
-
-// Transforms a mouse coordinates tuple to a rect bounds accordingly to the grid.
-SDL_Rect MouseCoordinatesToBounds(int gridWidth, int gridHeight, int cellSize, int mouseX, int mouseY, int extent)
-{
-    int cellX = mouseX / cellSize;
-    int cellY = mouseY / cellSize;
+    const SDL_Point cell = ScreenToCell(view, mouseX, mouseY);
+    int cellX = cell.x;
+    int cellY = cell.y;
 
     int xStart = std::max(0, cellX - extent);
     int yStart = std::max(0, cellY - extent);
     int xEnd = std::min(gridWidth - 1, cellX + extent);
     int yEnd = std::min(gridHeight - 1, cellY + extent);
 
-    return SDL_Rect{ xStart, yStart, xEnd, yEnd };
+    return CellBounds{ xStart, yStart, xEnd, yEnd };
 }
 
 // --------------------------------------------------------------------------------------------
 
-// Returns the particle located at x and y in the grid.
-Particle* GetParticleAt(Grid& cells, int gridWidth, int x, int y)
+// Transforms a mouse coordinates tuple to a row and column accordingly to the grid seen through the camera.
+SDL_Point MouseCoordinatesToXY(int gridWidth, int gridHeight, const Camera& view, int mouseX, int mouseY)
 {
-    int index = GetCellIndex(gridWidth, x, y);
-    if (index >= 0 && index < static_cast<int>(cells.size()))
-    {
-        return &cells[index];
-    }
-    return nullptr;
-}
-
-// --------------------------------------------------------------------------------------------
-
-// Transforms a mouse coordinates tuple to a row and column accordingly to the grid.
-SDL_Point MouseCoordinatesToXY(int gridWidth, int gridHeight, int cellSize, int mouseX, int mouseY)
-{
-    int x = mouseX / cellSize;
-    int y = mouseY / cellSize;
+    const SDL_Point cell = ScreenToCell(view, mouseX, mouseY);
+    int x = cell.x;
+    int y = cell.y;
 
     // Clamp the coordinates within the valid range
     x = std::max(0, std::min(x, gridWidth - 1));
@@ -294,157 +146,84 @@ SDL_Point MouseCoordinatesToXY(int gridWidth, int gridHeight, int cellSize, int
 
 // --------------------------------------------------------------------------------------------
 
-// Lights up a particle from the grid located at x and y.
-void RevealParticleAt(Grid& cells, int gridWidth, int x, int y)
-{
-    Particle* spawnParticle = GetParticleAt(cells, gridWidth, x, y);
-    if (spawnParticle)
-    {
-        spawnParticle->materialType = selectedMaterialType;
-        spawnParticle->spreadRules = GetParticleSpreadRules(spawnParticle->materialType);
-    }
-}
-
-// Lights up particles from the grid located in the bounds.
-void RevealParticlesAt(Grid& cells, int gridWidth, const SDL_Rect& bounds)
+// Updates the inputs related to the camera. The arrow keys and a drag with the middle button
+// pan the view, the mouse wheel zooms around the cursor.
+void UpdateCameraInputs(const SDL_Event& event, const ImGuiIO& io, int gridWidth, int gridHeight)
 {
-    int xStart = bounds.x;
-    int yStart = bounds.y;
-    int xEnd = bounds.w;
-    int yEnd = bounds.h;
+    static bool dragging = false;
+    static SDL_Point dragCell; // Cell kept under the cursor while dragging
 
-    int totalParticles = (xEnd - xStart + 1) * (yEnd - yStart + 1);
-
-    // Percentage of particles to reveal in each iteration
-    double revealPercentage = 0.2;
-    int particlesToReveal = static_cast<int>(totalParticles * revealPercentage);
-
-    int centerX = static_cast<int>(std::floor((xStart + xEnd) / 2));
-    int centerY = static_cast<int>(std::floor((yStart + yEnd) / 2));
-
-    for (int i = 0; i < particlesToReveal; ++i)
+    if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_MIDDLE && !io.WantCaptureMouse)
     {
-        float angle = RandomFloat(0.0f, 2.0f * M_PI);
-        float radius = RandomFloat(0.0f, std::min(centerX - xStart, centerY - yStart));
-        int x = static_cast<int>(centerX + radius * std::cos(angle));
-        int y = static_cast<int>(centerY + radius * std::sin(angle));
-
-        // Ensure the generated coordinates are within the bounds
-        x = std::max(xStart, std::min(x, xEnd));
-        y = std::max(yStart, std::min(y, yEnd));
-
-        RevealParticleAt(cells, gridWidth, x, y);
+        dragging = true;
+        dragCell = ScreenToCell(camera, event.button.x, event.button.y);
     }
-}
-
-// p1 becomes p2 and p2 becomes p1.
-void SwapParticles(Particle& p1, Particle& p2)
-{
-    std::swap(p1, p2);
-}
-
-// Updates the solid particle located at x and y on the grid.
-void UpdateSolid(Grid& cells, int gridWidth, int x, int y)
-{
-    Particle* solidParticle = GetParticleAt(cells, gridWidth, x, y);
-
-    // Get neighboring particles
-    Particle* bParticle = GetParticleAt(cells, gridWidth, x, y + 1); // Below
-    Particle* blParticle = GetParticleAt(cells, gridWidth, x - 1, y + 1); // Below left
-    Particle* brParticle = GetParticleAt(cells, gridWidth, x + 1, y + 1); // Below right
-
-    if (bParticle && (ParticleIsEmpty(*bParticle) || ParticleCanReplace(*solidParticle, *bParticle))) // Move down
+    else if (event.type == SDL_MOUSEBUTTONUP && event.button.button == SDL_BUTTON_MIDDLE)
     {
-        SwapParticles(*bParticle, *solidParticle);
+        dragging = false;
     }
-
-    else if (blParticle && ParticleIsEmpty(*blParticle)) // Move down and left
+    else if (event.type == SDL_MOUSEMOTION && dragging)
     {
-        SwapParticles(*blParticle, *solidParticle);
+        const SDL_Point cell = ScreenToCell(camera, event.motion.x, event.motion.y);
+        MoveCamera(camera, dragCell.x - cell.x, dragCell.y - cell.y, gridWidth, gridHeight);
     }
-
-    else if (brParticle && ParticleIsEmpty(*brParticle)) // Move down and right
+    else if (event.type == SDL_MOUSEWHEEL && event.wheel.y != 0 && !io.WantCaptureMouse)
     {
-        SwapParticles(*brParticle, *solidParticle);
+        int mouseX;
+        int mouseY;
+        SDL_GetMouseState(&mouseX, &mouseY);
+        ZoomCamera(camera, event.wheel.y > 0 ? 1 : -1, mouseX, mouseY, gridWidth, gridHeight);
     }
 }
 
-// Updates the liquid particle located at x and y on the grid.
-void UpdateLiquid(Grid& cells, int gridWidth, int x, int y)
+// Updates the inputs related the the material selection.
+void UpdateInputs(const SDL_Event& event, const ImGuiIO& io, SimulationThread& simulation, int gridWidth, int gridHeight)
 {
-    Particle* liquidParticle = GetParticleAt(cells, gridWidth, x, y);
-
-    // Get neighboring particles
-    Particle* lParticle = GetParticleAt(cells, gridWidth, x - 1, y); // Left
-    Particle* rParticle = GetParticleAt(cells, gridWidth, x + 1, y); // Right
+    static bool mouseDown = false;
 
-    Particle* bParticle = GetParticleAt(cells, gridWidth, x, y + 1); // Below
-    Particle* blParticle = GetParticleAt(cells, gridWidth, x - 1, y + 1); // Below left
-    Particle* brParticle = GetParticleAt(cells, gridWidth, x + 1, y + 1); // Below right
+    UpdateCameraInputs(event, io, gridWidth, gridHeight);
 
-    if (bParticle && (ParticleIsEmpty(*bParticle) || ParticleCanReplace(*liquidParticle, *bParticle))) // Move down
+    if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT)
     {
-        SwapParticles(*bParticle, *liquidParticle);
+        mouseDown = true;
     }
-
-    else if (blParticle && ParticleIsEmpty(*blParticle)) // Move down and left
+    else if (event.type == SDL_MOUSEBUTTONUP && event.button.button == SDL_BUTTON_LEFT)
     {
-        SwapParticles(*blParticle, *liquidParticle);
+        mouseDown = false;
     }
 
-    else if (brParticle && ParticleIsEmpty(*brParticle)) // Move down and right
+    // The arrow keys move the camera by an eighth of the view, F9 saves the trace
+    if (event.type == SDL_KEYDOWN && !io.WantCaptureKeyboard)
     {
-        SwapParticles(*brParticle, *liquidParticle);
-    }
+        const int stepX = std::max(1, GetVisibleColumns(camera, gridWidth) / 8);
+        const int stepY = std::max(1, GetVisibleRows(camera, gridHeight) / 8);
 
-    else if (lParticle && ParticleIsEmpty(*lParticle)) // Move left
-    {
-        SwapParticles(*lParticle, *liquidParticle);
-    }
+        switch (event.key.keysym.sym)
+        {
+        case SDLK_LEFT:
+            MoveCamera(camera, -stepX, 0, gridWidth, gridHeight);
+            break;
 
-    else if (rParticle && ParticleIsEmpty(*rParticle)) // Move right
-    {
-        SwapParticles(*rParticle, *liquidParticle);
-    }
-}
+        case SDLK_RIGHT:
+            MoveCamera(camera, stepX, 0, gridWidth, gridHeight);
+            break;
 
-// Updates the gas particle located at x and y on the grid.
-void UpdateGas(Grid& cells, int gridWidth, int x, int y)
-{
-    Particle* gasParticle = GetParticleAt(cells, gridWidth, x, y);
+        case SDLK_UP:
+            MoveCamera(camera, 0, -stepY, gridWidth, gridHeight);
+            break;
 
-    Particle* aParticle = GetParticleAt(cells, gridWidth, x, y - 1); // Above
-    Particle* lParticle = GetParticleAt(cells, gridWidth, x - 1, y); // Left
-    Particle* rParticle = GetParticleAt(cells, gridWidth, x + 1, y); // Right
-    Particle* bParticle = GetParticleAt(cells, gridWidth, x, y + 1); // Below
+        case SDLK_DOWN:
+            MoveCamera(camera, 0, stepY, gridWidth, gridHeight);
+            break;
 
-    // Randomly select a direction to move
-    std::vector<Particle*> directions = { aParticle, lParticle, rParticle, bParticle };
-    std::shuffle(std::begin(directions), std::end(directions), rng);
+        case SDLK_F9:
+            WriteTraceFile(TRACE_FILE_NAME);
+            break;
 
-    for (const auto& direction : directions)
-    {
-        if (direction && (ParticleIsEmpty(*direction) || ParticleCanReplace(*gasParticle, *direction)))
-        {
-            SwapParticles(*direction, *gasParticle);
+        default:
             break;
         }
     }
-}
-
-// Updates the inputs related the the material selection.
-void UpdateInputs(const SDL_Event& event, const ImGuiIO& io, Grid& cells, int gridWidth, int gridHeight)
-{
-    static bool mouseDown = false;
-
-    if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT)
-    {
-        mouseDown = true;
-    }
-    else if (event.type == SDL_MOUSEBUTTONUP && event.button.button == SDL_BUTTON_LEFT)
-    {
-        mouseDown = false;
-    }
 
     if (mouseDown && !io.WantCaptureMouse)
     {
@@ -456,8 +235,13 @@ void UpdateInputs(const SDL_Event& event, const ImGuiIO& io, Grid& cells, int gr
         {
         case BrushType::Small:
         {
-            const SDL_Point coords = MouseCoordinatesToXY(gridWidth, gridHeight, CELL_SIZE, mouseX, mouseY);
-            RevealParticleAt(cells, gridWidth, coords.x, coords.y);
+            const SDL_Point coords = MouseCoordinatesToXY(gridWidth, gridHeight, camera, mouseX, mouseY);
+            SimulationCommand command = {};
+            command.type = SimulationCommand::Type::RevealParticle;
+            command.x = coords.x;
+            command.y = coords.y;
+            command.materialType = selectedMaterialType;
+            simulation.PushCommand(command);
             break;
         }
 
@@ -465,8 +249,12 @@ void UpdateInputs(const SDL_Event& event, const ImGuiIO& io, Grid& cells, int gr
         case BrushType::Big:
         {
             int brushSize = static_cast<std::underlying_type<BrushType>::type>(selectedBrushType);
-            const SDL_Rect bounds = MouseCoordinatesToBounds(gridWidth, gridHeight, CELL_SIZE, mouseX, mouseY, brushSize);
-            RevealParticlesAt(cells, gridWidth, bounds);
+            const CellBounds bounds = MouseCoordinatesToBounds(gridWidth, gridHeight, camera, mouseX, mouseY, brushSize);
+            SimulationCommand command = {};
+            command.type = SimulationCommand::Type::RevealParticles;
+            command.bounds = bounds;
+            command.materialType = selectedMaterialType;
+            simulation.PushCommand(command);
             break;
         }
         default:
@@ -475,49 +263,7 @@ void UpdateInputs(const SDL_Event& event, const ImGuiIO& io, Grid& cells, int gr
     }
 }
 
-// Updates the particles motion.
-void UpdateParticleSimulation(SDL_Renderer* renderer, Grid& cells, int gridWidth, int gridHeight)
-{
-    for (int y = gridHeight - 1; y > 0; y--)
-    {
-        for (int x = 0; x < gridWidth; x++)
-        {
-            MaterialType matType = GetParticleAt(cells, gridWidth, x, y)->materialType;
-
-            switch (matType)
-            {
-            case MaterialType::Sand:
-                UpdateSolid(cells, gridWidth, x, y);
-                break;
-
-            case MaterialType::Lava:
-            case MaterialType::Water:
-                UpdateLiquid(cells, gridWidth, x, y);
-                break;
-
-            case MaterialType::Acid:
-            case MaterialType::ToxicGas:
-                UpdateGas(cells, gridWidth, x, y);
-                break;
-
-            default:
-                break;
-            }
-        }
-    }
-
-    for (int columnIndex = 0; columnIndex < gridHeight; columnIndex++)
-    {
-        for (int rowIndex = 0; rowIndex < gridWidth; rowIndex++)
-        {
-            Particle* currentParticle = GetParticleAt(cells, gridWidth, rowIndex, columnIndex);
-            SDL_Rect rect = CellToRect(rowIndex, columnIndex, CELL_SIZE);
-            SDL_Color color = currentParticle->spreadRules.contactColors[MaterialType::None]; // FIX ME
-            SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-            SDL_RenderFillRect(renderer, &rect);
-        }
-    }
-}
+// --------------------------------------------------------------------------------------------
 
 // Renders the UI related to the brush type selection.
 void RenderBrushSelectionDropdown()
@@ -617,8 +363,70 @@ void RenderMaterialSelectionDropdown()
     }
 }
 
+// Renders the UI related to the behavior of the grid edges.
+void RenderBoundarySelectionDropdown(SimulationThread& simulation)
+{
+    static std::vector<BoundaryMode> boundaryOptions = { BoundaryMode::Solid, BoundaryMode::Wrap, BoundaryMode::Open };
+
+    if (ImGui::BeginCombo("Boundary", GetBoundaryModeName(selectedBoundaryMode)))
+    {
+        for (BoundaryMode boundaryMode : boundaryOptions)
+        {
+            bool isSelected = (selectedBoundaryMode == boundaryMode);
+
+            if (ImGui::Selectable(GetBoundaryModeName(boundaryMode), isSelected))
+            {
+                selectedBoundaryMode = boundaryMode;
+
+                SimulationCommand command = {};
+                command.type = SimulationCommand::Type::SetBoundaryMode;
+                command.boundaryMode = boundaryMode;
+                simulation.PushCommand(command);
+
+                if (isSelected)
+                {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+        }
+
+        ImGui::EndCombo();
+    }
+}
+
+// Renders the UI related to the cells visited by a simulation step.
+void RenderStepModeSelectionDropdown(SimulationThread& simulation)
+{
+    static std::vector<StepMode> stepModeOptions = { StepMode::Rects, StepMode::ActiveCells, StepMode::SandBits };
+
+    if (ImGui::BeginCombo("Step mode", GetStepModeName(selectedStepMode)))
+    {
+        for (StepMode stepMode : stepModeOptions)
+        {
+            bool isSelected = (selectedStepMode == stepMode);
+
+            if (ImGui::Selectable(GetStepModeName(stepMode), isSelected))
+            {
+                selectedStepMode = stepMode;
+
+                SimulationCommand command = {};
+                command.type = SimulationCommand::Type::SetStepMode;
+                command.stepMode = stepMode;
+                simulation.PushCommand(command);
+
+                if (isSelected)
+                {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+        }
+
+        ImGui::EndCombo();
+    }
+}
+
 // Renders the entire UI in one same call.
-void RenderImGui()
+void RenderImGui(SimulationThread& simulation)
 {
     ImGui::NewFrame();
 
@@ -626,6 +434,31 @@ void RenderImGui()
     {
         RenderBrushSelectionDropdown();
         RenderMaterialSelectionDropdown();
+        RenderBoundarySelectionDropdown(simulation);
+        RenderStepModeSelectionDropdown(simulation);
+
+        if (ImGui::Checkbox("Multithreaded", &useMultithreading))
+        {
+            simulation.SetMultithreading(useMultithreading);
+        }
+
+        if (ImGui::SliderInt("Ticks per second", &tickRate, 0, 1000, tickRate == 0 ? "Unlimited" : "%d"))
+        {
+            simulation.SetTickRate(tickRate);
+        }
+
+        if (ImGui::SliderFloat("Fast-forward (ms)", &stepBudget, 0.0f, 50.0f, stepBudget == 0.0f ? "Off" : "%.1f"))
+        {
+            simulation.SetStepBudget(stepBudget);
+        }
+
+        ImGui::Text("Steps per frame: %.1f, per tick: %d", stepsPerFrame, simulation.GetStepsPerTick());
+        ImGui::Text("Ticks: %llu, behind: %llu, dropped: %llu",
+                    static_cast<unsigned long long>(simulation.GetTickCount()),
+                    static_cast<unsigned long long>(simulation.GetBehindTickCount()),
+                    static_cast<unsigned long long>(simulation.GetDroppedTickCount()));
+
+        RenderPerfHud(perfHud);
 
         ImGui::End();
     }
@@ -650,12 +483,18 @@ void Shutdown(SDL_Window* window, SDL_Renderer* renderer)
 
 int main(int argc, char* argv[])
 {
+    AppConfig config;
+    if (!ParseArguments(argc, argv, config))
+    {
+        return -1;
+    }
+
     SDL_Window* window = nullptr;
     SDL_Renderer* renderer = nullptr;
 
     bool shouldQuit = false;
 
-    if (!InitSDL(window, renderer) || !InitImGui(window, renderer))
+    if (!InitSDL(window, renderer, config.windowWidth, config.windowHeight) || !InitImGui(window, renderer))
     {
         std::cout << "Error on SDL or ImGui init!" << std::endl;
         return -1;
@@ -664,26 +503,52 @@ int main(int argc, char* argv[])
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     SDL_RenderClear(renderer);
 
-    const int gridWidth = WINDOW_WIDTH / CELL_SIZE;
-    const int gridHeight = WINDOW_HEIGHT / CELL_SIZE;
+    const int gridWidth = GetGridWidth(config);
+    const int gridHeight = GetGridHeight(config);
+
+    camera.cellSize = config.cellSize;
+    camera.viewWidth = config.windowWidth;
+    camera.viewHeight = config.windowHeight;
+
+    InitMaterialTable();
+
+    Grid cells(gridWidth, gridHeight);
+    cells.seed = std::random_device{}();
+    ThreadPool pool(std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
 
-    Grid cells;
-    for (int i = 0; i < gridWidth * gridHeight; i++)
+    SimulationThread simulation(cells, pool);
+    simulation.SetTickRate(tickRate);
+
+    GridRenderer gridRenderer;
+    if (!InitGridRenderer(gridRenderer, renderer, simulation.AcquireSnapshot(), config.windowWidth, config.windowHeight))
     {
-        Particle particle(GetParticleSpreadRules(MaterialType::None));
-        cells.push_back(particle);
+        Shutdown(window, renderer);
+        return -1;
     }
 
+    std::cout << "Grid: " << gridWidth << "x" << gridHeight << " cells, "
+              << BYTES_PER_CELL << " bytes per cell, "
+              << static_cast<long long>(cells.Size()) * BYTES_PER_CELL / 1024 << " KiB" << std::endl;
+
+    // From now on the grid is only touched by the simulation thread
+    simulation.Start();
+
     const ImGuiIO& io = ImGui::GetIO();
+    uint32_t renderedFrame = 0;
+
+    SetTraceThreadName("Main");
 
     // Game loop
     while (!shouldQuit)
     {
+        TraceFrame();
+        uint64_t phaseStart = StartPerfTimer(perfHud);
+
         SDL_Event event;
         while (SDL_PollEvent(&event))
         {
             ImGui_ImplSDL2_ProcessEvent(&event);
-            UpdateInputs(event, io, cells, gridWidth, gridHeight);
+            UpdateInputs(event, io, simulation, gridWidth, gridHeight);
 
             if (event.type == SDL_QUIT)
             {
@@ -691,22 +556,42 @@ int main(int argc, char* argv[])
             }
         }
 
+        StopPerfTimer(perfHud, PerfPhase::Events, phaseStart);
+        RecordPerfSample(perfHud, PerfPhase::Physics, simulation.GetTickMilliseconds());
+
+        // Steps completed since the last frame, smoothed to stay readable
+        const GridSnapshot& snapshot = simulation.AcquireSnapshot();
+        stepsPerFrame += (static_cast<float>(snapshot.frame - renderedFrame) - stepsPerFrame) * 0.05f;
+        renderedFrame = snapshot.frame;
+
         ImGui_ImplSDLRenderer2_NewFrame();
         ImGui_ImplSDL2_NewFrame();
 
-        RenderImGui();
+        phaseStart = StartPerfTimer(perfHud);
+        RenderImGui(simulation);
+        StopPerfTimer(perfHud, PerfPhase::ImGuiBuild, phaseStart);
 
         SDL_RenderClear(renderer);
         SDL_RenderSetScale(renderer, io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
 
-        UpdateParticleSimulation(renderer, cells, gridWidth, gridHeight);
+        phaseStart = StartPerfTimer(perfHud);
+        RenderParticles(gridRenderer, renderer, snapshot, camera);
+        StopPerfTimer(perfHud, PerfPhase::CellRender, phaseStart);
 
+        phaseStart = StartPerfTimer(perfHud);
         ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData());
+        StopPerfTimer(perfHud, PerfPhase::ImGuiDraw, phaseStart);
 
+        // Paced by vsync, the simulation runs at its own rate
+        phaseStart = StartPerfTimer(perfHud);
         SDL_RenderPresent(renderer);
-        SDL_Delay(10);
+        StopPerfTimer(perfHud, PerfPhase::Present, phaseStart);
+
+        EndPerfFrame(perfHud);
     }
 
+    simulation.Stop();
+    DestroyGridRenderer(gridRenderer);
     Shutdown(window, renderer);
 
     return 0;
@@ -0,0 +1,96 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#include "perf_hud.h"
+#include "engine/simd.h"
+
+#include <cfloat>
+#include <algorithm>
+
+#include <imgui.h>
+
+static const char* PERF_PHASE_NAMES[PERF_PHASE_COUNT] = {
+    "Events", "Physics", "Cell render", "ImGui build", "ImGui draw", "Present"
+};
+
+void StopPerfTimer(PerfHud& hud, PerfPhase phase, uint64_t start)
+{
+    if (start == 0)
+    {
+        return;
+    }
+
+    const uint64_t end = GetTraceTime();
+
+    if (hud.enabled)
+    {
+        hud.samples[static_cast<int>(phase)][hud.nextSample] = static_cast<float>((end - start) * 1e-6);
+    }
+
+    if (IsTraceEnabled())
+    {
+        RecordTraceZone(PERF_PHASE_NAMES[static_cast<int>(phase)], start, end);
+    }
+}
+
+void EndPerfFrame(PerfHud& hud)
+{
+    if (hud.enabled)
+    {
+        hud.nextSample = (hud.nextSample + 1) % PERF_HISTORY_SIZE;
+        hud.sampleCount = std::min(hud.sampleCount + 1, PERF_HISTORY_SIZE);
+    }
+}
+
+void RenderPerfHud(PerfHud& hud)
+{
+    if (!ImGui::CollapsingHeader("Performance"))
+    {
+        return;
+    }
+
+    if (ImGui::Checkbox("Timers", &hud.enabled) && hud.enabled)
+    {
+        // Samples from before the timers were stopped would skew the statistics
+        hud.nextSample = 0;
+        hud.sampleCount = 0;
+    }
+
+    ImGui::Text("SIMD path: %s", GetSimdPathName(GetSimdPath()));
+
+    bool recordTrace = IsTraceEnabled();
+    if (ImGui::Checkbox("Record trace (F9 saves it)", &recordTrace))
+    {
+        SetTraceEnabled(recordTrace);
+    }
+
+    if (!hud.enabled || hud.sampleCount == 0)
+    {
+        return;
+    }
+
+    // The oldest sample is the first plotted, once the history has wrapped around
+    const int plotOffset = hud.sampleCount < PERF_HISTORY_SIZE ? 0 : hud.nextSample;
+    float sorted[PERF_HISTORY_SIZE];
+
+    for (int phase = 0; phase < PERF_PHASE_COUNT; phase++)
+    {
+        const float* samples = hud.samples[phase];
+
+        float total = 0.0f;
+        for (int i = 0; i < hud.sampleCount; i++)
+        {
+            total += samples[i];
+        }
+
+        std::copy(samples, samples + hud.sampleCount, sorted);
+        const int p99Index = hud.sampleCount * 99 / 100;
+        std::nth_element(sorted, sorted + p99Index, sorted + hud.sampleCount);
+
+        ImGui::Text("%-12s avg %6.3f ms  p99 %6.3f ms", PERF_PHASE_NAMES[phase], total / hud.sampleCount, sorted[p99Index]);
+        ImGui::PlotLines(PERF_PHASE_NAMES[phase], samples, hud.sampleCount, plotOffset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+    }
+}
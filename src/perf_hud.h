@@ -0,0 +1,62 @@
+/****************************************************************************\
+ * Pilot Alex, 2022-2024, All right reserved. Copyright (c).                *
+ * Made by A.G. under the username of Pilot Alex.                           *
+ * C++14, Visual Studio 2022.                                               *
+\****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+#include "engine/trace.h"
+
+// Parts of a frame timed by the performance HUD.
+enum class PerfPhase
+{
+    Events, // Event polling and UpdateInputs
+    Physics, // Simulation steps of the last tick, on the simulation thread
+    CellRender, // RenderParticles
+    ImGuiBuild, // RenderImGui
+    ImGuiDraw, // ImGui_ImplSDLRenderer2_RenderDrawData
+    Present, // SDL_RenderPresent
+    Count
+};
+
+constexpr int PERF_PHASE_COUNT = static_cast<int>(PerfPhase::Count);
+constexpr int PERF_HISTORY_SIZE = 240; // Frames kept per phase, a few seconds at 60 Hz
+
+// Durations in milliseconds of the last frames, per phase. The phases are also recorded as
+// trace zones while tracing. Nothing is timed while both are disabled, so the HUD only costs
+// a branch per phase.
+struct PerfHud
+{
+    bool enabled = false;
+    float samples[PERF_PHASE_COUNT][PERF_HISTORY_SIZE] = {};
+    int nextSample = 0; // Slot the next frame is written to, the same for every phase
+    int sampleCount = 0;
+};
+
+// Returns the time to give to StopPerfTimer, or 0 while the HUD and tracing are disabled.
+inline uint64_t StartPerfTimer(const PerfHud& hud)
+{
+    return hud.enabled || IsTraceEnabled() ? GetTraceTime() : 0;
+}
+
+// Records the time elapsed since StartPerfTimer as the duration of the phase this frame.
+void StopPerfTimer(PerfHud& hud, PerfPhase phase, uint64_t start);
+
+// Records a duration measured elsewhere, like on the simulation thread.
+inline void RecordPerfSample(PerfHud& hud, PerfPhase phase, float milliseconds)
+{
+    if (hud.enabled)
+    {
+        hud.samples[static_cast<int>(phase)][hud.nextSample] = milliseconds;
+    }
+}
+
+// Moves on to the next frame once every phase was recorded.
+void EndPerfFrame(PerfHud& hud);
+
+// Renders the enable checkboxes then, while enabled, the rolling average, the 99th percentile
+// and a plot of every phase.
+void RenderPerfHud(PerfHud& hud);